@@ -0,0 +1,419 @@
+#include "batch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch_block.h"
+
+// Allocating lanes in multiples of the widest width regardless of the one in
+// use keeps the layout of a batch the same on every platform.
+#define MAX_SIM_BATCH_WIDTH 8
+#define ALIGNMENT 32
+
+static size_t reserve(size_t *size, size_t array_size);
+static void store_lane(struct sim_batch *batch, int lane,
+                       const struct sim *sim);
+static void freeze_lane(struct sim_batch *batch, int lane);
+static struct paddle_constants make_paddle_constants(struct paddle paddle);
+static bool is_block_active(const struct sim_batch *batch, int i, int width);
+static void update_times(int length, double tick_duration,
+                         double *restrict time,
+                         const double *restrict serve_start,
+                         float *restrict served, int *restrict ticks);
+static void check_lane(struct sim_batch *batch, int lane);
+static void score_point(struct sim_batch *batch, int lane);
+
+bool init_sim_batch(struct sim_batch *batch, int length,
+                    double tick_duration) {
+    *batch = (struct sim_batch){0};
+    batch->length = length;
+    batch->capacity = ((length + MAX_SIM_BATCH_WIDTH - 1) /
+                       MAX_SIM_BATCH_WIDTH) *
+                      MAX_SIM_BATCH_WIDTH;
+    batch->tick_duration = tick_duration;
+    batch->width = get_sim_batch_width();
+
+    float **float_arrays[] = {
+        &batch->paddle_1_y,
+        &batch->paddle_1_velocity,
+        &batch->paddle_2_y,
+        &batch->paddle_2_velocity,
+        &batch->ghost_1_speed,
+        &batch->ghost_1_bias,
+        &batch->ghost_1_idle_offset,
+        &batch->ghost_2_speed,
+        &batch->ghost_2_bias,
+        &batch->ghost_2_idle_offset,
+        &batch->ball_x,
+        &batch->ball_y,
+        &batch->ball_velocity_x,
+        &batch->ball_velocity_y,
+        &batch->prediction_y,
+        &batch->prediction_x,
+        &batch->served,
+        &batch->ghosts_sharpness,
+        &batch->ghost_1_max_bias,
+        &batch->ghost_2_max_bias,
+    };
+    int **int_arrays[] = {
+        &batch->ticks,
+        &batch->score_1,
+        &batch->score_2,
+        &batch->max_score,
+        &batch->prediction_paddle_no,
+        &batch->ghost_1_max_idle_offset,
+        &batch->ghost_2_max_idle_offset,
+        &batch->finished_lanes,
+    };
+    int float_arrays_length = sizeof(float_arrays) / sizeof(float_arrays[0]);
+    int int_arrays_length = sizeof(int_arrays) / sizeof(int_arrays[0]);
+
+    size_t n = batch->capacity;
+    size_t size = 0;
+    size_t float_offsets[sizeof(float_arrays) / sizeof(float_arrays[0])];
+    for (int i = 0; i < float_arrays_length; i++) {
+        float_offsets[i] = reserve(&size, n * sizeof(float));
+    }
+    size_t int_offsets[sizeof(int_arrays) / sizeof(int_arrays[0])];
+    for (int i = 0; i < int_arrays_length; i++) {
+        int_offsets[i] = reserve(&size, n * sizeof(int));
+    }
+    size_t time_offset = reserve(&size, n * sizeof(double));
+    size_t prediction_time_offset = reserve(&size, n * sizeof(double));
+    size_t serve_start_offset = reserve(&size, n * sizeof(double));
+    size_t serve_time_offset = reserve(&size, n * sizeof(uint32_t));
+    size_t rng_offset = reserve(&size, n * sizeof(struct rng));
+    size_t active_offset = reserve(&size, n * sizeof(bool));
+
+    // The block itself is only guaranteed to be aligned for the largest
+    // standard type, so room is made to align it by hand.
+    batch->memory = calloc(1, size + ALIGNMENT);
+    if (batch->memory == NULL) {
+        return false;
+    }
+    char *base = (char *)(((uintptr_t)batch->memory + ALIGNMENT - 1) &
+                          ~(uintptr_t)(ALIGNMENT - 1));
+
+    for (int i = 0; i < float_arrays_length; i++) {
+        *float_arrays[i] = (float *)(base + float_offsets[i]);
+    }
+    for (int i = 0; i < int_arrays_length; i++) {
+        *int_arrays[i] = (int *)(base + int_offsets[i]);
+    }
+    batch->time = (double *)(base + time_offset);
+    batch->prediction_time = (double *)(base + prediction_time_offset);
+    batch->serve_start = (double *)(base + serve_start_offset);
+    batch->serve_time = (uint32_t *)(base + serve_time_offset);
+    batch->rng = (struct rng *)(base + rng_offset);
+    batch->active = (bool *)(base + active_offset);
+
+    for (int lane = 0; lane < batch->capacity; lane++) {
+        clear_sim_batch_lane(batch, lane);
+    }
+    return true;
+}
+
+// Return the number of lanes stepped by a single SIMD instruction, the widest
+// the build and the processor support.
+int get_sim_batch_width(void) {
+#if defined(SIM_BATCH_RUNTIME_AVX)
+    if (__builtin_cpu_supports("avx")) {
+        return 8;
+    }
+#endif
+    return BLOCK_WIDTH;
+}
+
+static size_t reserve(size_t *size, size_t array_size) {
+    size_t offset = (*size + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+    *size = offset + array_size;
+    return offset;
+}
+
+void destroy_sim_batch(struct sim_batch *batch) {
+    free(batch->memory);
+    *batch = (struct sim_batch){0};
+}
+
+// Start simulating the given game in a lane. Only games between two active
+// ghosts with paddles and balls of the default sizes are supported.
+void set_sim_batch_lane(struct sim_batch *batch, int lane,
+                        const struct sim *sim) {
+    store_lane(batch, lane, sim);
+    batch->ticks[lane] = 0;
+    batch->active[lane] = true;
+}
+
+// Store a game in a lane.
+static void store_lane(struct sim_batch *batch, int lane,
+                       const struct sim *sim) {
+    batch->paddle_1_y[lane] = sim->paddle_1.rect.y;
+    batch->paddle_1_velocity[lane] = sim->paddle_1.velocity;
+    batch->paddle_2_y[lane] = sim->paddle_2.rect.y;
+    batch->paddle_2_velocity[lane] = sim->paddle_2.velocity;
+    batch->ghost_1_speed[lane] = sim->ghost_1.speed;
+    batch->ghost_1_bias[lane] = sim->ghost_1.bias;
+    batch->ghost_1_idle_offset[lane] = sim->ghost_1.idle_offset;
+    batch->ghost_2_speed[lane] = sim->ghost_2.speed;
+    batch->ghost_2_bias[lane] = sim->ghost_2.bias;
+    batch->ghost_2_idle_offset[lane] = sim->ghost_2.idle_offset;
+    batch->ball_x[lane] = sim->ball.rect.x;
+    batch->ball_y[lane] = sim->ball.rect.y;
+    batch->ball_velocity_x[lane] = sim->ball.velocity.x;
+    batch->ball_velocity_y[lane] = sim->ball.velocity.y;
+    batch->prediction_y[lane] = sim->prediction.y;
+    batch->served[lane] = sim->ball.served ? 1.0f : 0.0f;
+    batch->time[lane] = sim->time;
+    batch->prediction_paddle_no[lane] = sim->prediction.paddle_no;
+    batch->prediction_x[lane] = sim->prediction.x;
+    batch->prediction_time[lane] = sim->prediction.time;
+    batch->serve_start[lane] = sim->ball.serve_time;
+    batch->serve_time[lane] = sim->ball.serve_time;
+    batch->score_1[lane] = sim->paddle_1.score;
+    batch->score_2[lane] = sim->paddle_2.score;
+    batch->max_score[lane] = sim->max_score;
+    batch->ghosts_sharpness[lane] = sim->ghosts_sharpness;
+    batch->ghost_1_max_bias[lane] = sim->ghost_1.max_bias;
+    batch->ghost_1_max_idle_offset[lane] = sim->ghost_1.max_idle_offset;
+    batch->ghost_2_max_bias[lane] = sim->ghost_2.max_bias;
+    batch->ghost_2_max_idle_offset[lane] = sim->ghost_2.max_idle_offset;
+    batch->rng[lane] = sim->rng;
+}
+
+// Stop simulating a lane. The paddles of a cleared lane keep moving but its
+// ball stays unserved in the middle of the court where nothing can happen to
+// it.
+void clear_sim_batch_lane(struct sim_batch *batch, int lane) {
+    struct sim sim = {0};
+    sim.paddle_1 = make_paddle(1);
+    sim.paddle_2 = make_paddle(2);
+    sim.ball.rect.x = (LOGICAL_WIDTH - BALL_SIZE) / 2.0f;
+    sim.ball.rect.y = (LOGICAL_HEIGHT - BALL_SIZE) / 2.0f;
+    store_lane(batch, lane, &sim);
+    freeze_lane(batch, lane);
+}
+
+static void freeze_lane(struct sim_batch *batch, int lane) {
+    batch->served[lane] = 0.0f;
+    batch->serve_start[lane] = INFINITY;
+    batch->active[lane] = false;
+}
+
+struct sim get_sim_batch_lane(const struct sim_batch *batch, int lane) {
+    struct sim sim = {0};
+    sim.rng = batch->rng[lane];
+
+    sim.paddle_1 = make_paddle(1);
+    sim.paddle_1.rect.y = batch->paddle_1_y[lane];
+    sim.paddle_1.velocity = batch->paddle_1_velocity[lane];
+    sim.paddle_1.score = batch->score_1[lane];
+    sim.paddle_2 = make_paddle(2);
+    sim.paddle_2.rect.y = batch->paddle_2_y[lane];
+    sim.paddle_2.velocity = batch->paddle_2_velocity[lane];
+    sim.paddle_2.score = batch->score_2[lane];
+
+    sim.ghosts_sharpness = batch->ghosts_sharpness[lane];
+    sim.ghost_1 = (struct ghost){
+        .idle_offset = batch->ghost_1_idle_offset[lane],
+        .speed = batch->ghost_1_speed[lane],
+        .bias = batch->ghost_1_bias[lane],
+        .active = true,
+        .velocity = batch->paddle_1_velocity[lane],
+        .max_bias = batch->ghost_1_max_bias[lane],
+        .max_idle_offset = batch->ghost_1_max_idle_offset[lane],
+    };
+    sim.ghost_2 = (struct ghost){
+        .idle_offset = batch->ghost_2_idle_offset[lane],
+        .speed = batch->ghost_2_speed[lane],
+        .bias = batch->ghost_2_bias[lane],
+        .active = true,
+        .velocity = batch->paddle_2_velocity[lane],
+        .max_bias = batch->ghost_2_max_bias[lane],
+        .max_idle_offset = batch->ghost_2_max_idle_offset[lane],
+    };
+
+    sim.ball = (struct ball){
+        .rect =
+            {
+                .x = batch->ball_x[lane],
+                .y = batch->ball_y[lane],
+                .w = BALL_SIZE,
+                .h = BALL_SIZE,
+            },
+        .velocity =
+            {
+                .x = batch->ball_velocity_x[lane],
+                .y = batch->ball_velocity_y[lane],
+            },
+        .served = batch->served[lane] > 0.0f,
+        .serve_time = batch->serve_time[lane],
+    };
+    sim.prediction = (struct ball_prediction){
+        .paddle_no = batch->prediction_paddle_no[lane],
+        .x = batch->prediction_x[lane],
+        .y = batch->prediction_y[lane],
+        .time = batch->prediction_time[lane],
+    };
+
+    sim.max_score = batch->max_score[lane];
+    sim.time = batch->time[lane];
+    return sim;
+}
+
+int get_sim_batch_lane_ticks(const struct sim_batch *batch, int lane) {
+    return batch->ticks[lane];
+}
+
+static struct paddle_constants make_paddle_constants(struct paddle paddle) {
+    struct paddle_constants constants = {
+        .no = paddle.no,
+        .x = paddle.rect.x,
+        .w = paddle.rect.w,
+        .max_y = LOGICAL_HEIGHT - paddle.rect.h,
+        .center_y = (LOGICAL_HEIGHT - paddle.rect.h) / 2.0f,
+        .half_h = paddle.rect.h / 2.0f,
+        .ball_offset = (paddle.rect.h - (float)BALL_SIZE) / 2.0f,
+        .max_speed = paddle.max_speed,
+    };
+    if (paddle.no == 1) {
+        constants.face_min_x = paddle.rect.x + (paddle.rect.w / 2.0f);
+        constants.face_max_x = paddle.rect.x + paddle.rect.w;
+    } else {
+        constants.face_min_x = paddle.rect.x;
+        constants.face_max_x = paddle.rect.x + (paddle.rect.w / 2.0f);
+    }
+    return constants;
+}
+
+// Step every active lane of the batch by a single tick.
+void update_sim_batch(struct sim_batch *batch) {
+    struct paddle_constants paddle_1 = make_paddle_constants(make_paddle(1));
+    struct paddle_constants paddle_2 = make_paddle_constants(make_paddle(2));
+
+    batch->finished_lanes_length = 0;
+    int width = batch->width;
+    float dt = batch->tick_duration;
+    for (int i = 0; i < batch->capacity; i += width) {
+        if (!is_block_active(batch, i, width)) {
+            continue;
+        }
+
+#if defined(SIM_BATCH_RUNTIME_AVX)
+        int bits =
+            (width != BLOCK_WIDTH)
+                ? update_sim_batch_block_avx(batch, i, dt, &paddle_1, &paddle_2)
+                : update_block(batch, i, dt, &paddle_1, &paddle_2);
+#else
+        int bits = update_block(batch, i, dt, &paddle_1, &paddle_2);
+#endif
+        for (int j = 0; bits != 0; j++, bits >>= 1) {
+            if (bits & 1) {
+                check_lane(batch, i + j);
+            }
+        }
+    }
+
+    update_times(batch->capacity, batch->tick_duration, batch->time,
+                 batch->serve_start, batch->served, batch->ticks);
+}
+
+// Return whether any of the lanes starting at the given index is active. The
+// lanes of a block that has none are left as they are, as there is nothing to
+// step in them.
+static bool is_block_active(const struct sim_batch *batch, int i, int width) {
+    bool active = false;
+    for (int j = 0; j < width; j++) {
+        active |= batch->active[i + j];
+    }
+    return active;
+}
+
+
+// Serve the balls at the end of the first tick starting once their serve time
+// has come, like update_ball() does, the times being added up the same way as
+// update_sim() adds them up. The arrays are passed on their own so that the
+// compiler knows they don't overlap and vectorizes the loop.
+static void update_times(int length, double tick_duration,
+                         double *restrict time,
+                         const double *restrict serve_start,
+                         float *restrict served, int *restrict ticks) {
+    for (int lane = 0; lane < length; lane++) {
+        served[lane] = (time[lane] >= serve_start[lane]) ? 1.0f : served[lane];
+        time[lane] += tick_duration;
+        ticks[lane]++;
+    }
+}
+
+
+// Run what follows the movement of the paddles in update_sim() on a single
+// lane whose ball hasn't moved yet. The ball only runs into the walls and
+// the paddles, so they are all that is taken out of the lane.
+static void check_lane(struct sim_batch *batch, int lane) {
+    struct paddle paddle_1 = make_paddle(1);
+    paddle_1.rect.y = batch->paddle_1_y[lane];
+    struct paddle paddle_2 = make_paddle(2);
+    paddle_2.rect.y = batch->paddle_2_y[lane];
+    struct ball ball = {
+        .rect =
+            {
+                .x = batch->ball_x[lane],
+                .y = batch->ball_y[lane],
+                .w = BALL_SIZE,
+                .h = BALL_SIZE,
+            },
+        .velocity =
+            {
+                .x = batch->ball_velocity_x[lane],
+                .y = batch->ball_velocity_y[lane],
+            },
+        .served = true,
+    };
+    double time = batch->time[lane];
+    struct ball_contacts contacts = update_ball(
+        &ball, &paddle_1, &paddle_2, batch->tick_duration, time);
+
+    batch->ball_x[lane] = ball.rect.x;
+    batch->ball_y[lane] = ball.rect.y;
+    batch->ball_velocity_x[lane] = ball.velocity.x;
+    batch->ball_velocity_y[lane] = ball.velocity.y;
+
+    // The same as update_sim_ball() does.
+    if (contacts.paddle_no != 0) {
+        struct rng *rng = &batch->rng[lane];
+        struct ball_prediction prediction =
+            predict_ball(rng, ball, batch->ghosts_sharpness[lane],
+                         time + batch->tick_duration);
+        batch->prediction_paddle_no[lane] = prediction.paddle_no;
+        batch->prediction_x[lane] = prediction.x;
+        batch->prediction_y[lane] = prediction.y;
+        batch->prediction_time[lane] = prediction.time;
+
+        float *bias = (contacts.paddle_no == 1) ? &batch->ghost_2_bias[lane]
+                                                : &batch->ghost_1_bias[lane];
+        struct ghost ghost = {
+            .max_bias = (contacts.paddle_no == 1)
+                            ? batch->ghost_2_max_bias[lane]
+                            : batch->ghost_1_max_bias[lane],
+        };
+        set_ghost_bias(&ghost, rng);
+        *bias = ghost.bias;
+    }
+
+    if (ball.rect.x + ball.rect.w < 0 || ball.rect.x > LOGICAL_WIDTH) {
+        score_point(batch, lane);
+    }
+}
+
+// Score the point of a lane whose ball left the court, which only happens
+// once per point, with the scalar code of update_sim() on the whole game.
+static void score_point(struct sim_batch *batch, int lane) {
+    struct sim sim = get_sim_batch_lane(batch, lane);
+    check_paddle_missed_ball(&sim);
+    check_round_over(&sim);
+    store_lane(batch, lane, &sim);
+
+    if (sim.round_over) {
+        freeze_lane(batch, lane);
+        batch->finished_lanes[batch->finished_lanes_length++] = lane;
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+// A batch of independent ghost against ghost games whose hot state is kept in
+// contiguous arrays, one element per game (lane), so that all of them can be
+// stepped at once with SIMD instructions. The rare branches of a tick, such as
+// a paddle hitting or missing the ball, are detected with lane masks and
+// handled one lane at a time by the scalar code in sim.c, which keeps the
+// results of every lane identical to the ones of a struct sim stepped with
+// update_ghosts() and update_sim().
+
+// Define SIM_BATCH_NO_SIMD to step the lanes one at a time with the same code
+// on any platform. On x86 with GCC or Clang, AVX is used when the processor
+// supports it even if the build doesn't target it.
+
+struct sim_batch {
+    int length;
+    // The length rounded up to a multiple of the widest SIMD width.
+    int capacity;
+    double tick_duration; // in seconds
+    int width; // as returned by get_sim_batch_width()
+
+    // Hot state, stepped every tick.
+    float *paddle_1_y;
+    float *paddle_1_velocity;
+    float *paddle_2_y;
+    float *paddle_2_velocity;
+    float *ghost_1_speed;
+    float *ghost_1_bias;
+    float *ghost_1_idle_offset;
+    float *ghost_2_speed;
+    float *ghost_2_bias;
+    float *ghost_2_idle_offset;
+    float *ball_x;
+    float *ball_y;
+    float *ball_velocity_x;
+    float *ball_velocity_y;
+    float *prediction_y;
+    float *served; // 1 when the balls are served, otherwise 0
+    double *time;
+    double *serve_start; // the serve time, or infinity in frozen lanes
+
+    // Cold state, only touched when a lane needs the scalar code.
+    int *prediction_paddle_no;
+    float *prediction_x;
+    double *prediction_time;
+    uint32_t *serve_time;
+    int *ticks;
+    int *score_1;
+    int *score_2;
+    int *max_score;
+    float *ghosts_sharpness;
+    float *ghost_1_max_bias;
+    int *ghost_1_max_idle_offset;
+    float *ghost_2_max_bias;
+    int *ghost_2_max_idle_offset;
+    struct rng *rng;
+    bool *active;
+
+    // The lanes whose round got over during the last call to
+    // update_sim_batch(). They stay frozen until they are set again, and
+    // their tick count is only valid until the next call.
+    int *finished_lanes;
+    int finished_lanes_length;
+
+    void *memory;
+};
+
+int get_sim_batch_width(void);
+bool init_sim_batch(struct sim_batch *batch, int length, double tick_duration);
+void destroy_sim_batch(struct sim_batch *batch);
+void set_sim_batch_lane(struct sim_batch *batch, int lane,
+                        const struct sim *sim);
+void clear_sim_batch_lane(struct sim_batch *batch, int lane);
+struct sim get_sim_batch_lane(const struct sim_batch *batch, int lane);
+int get_sim_batch_lane_ticks(const struct sim_batch *batch, int lane);
+void update_sim_batch(struct sim_batch *batch);
@@ -0,0 +1,13 @@
+// The block step built for AVX on its own, for update_sim_batch() to pick when
+// the processor supports AVX but the build doesn't target it.
+#define SIM_BATCH_AVX_BLOCK
+#include "batch_block.h"
+
+#if defined(SIM_BATCH_RUNTIME_AVX)
+BLOCK_TARGET int
+update_sim_batch_block_avx(struct sim_batch *batch, int i, float dt,
+                           const struct paddle_constants *paddle_1,
+                           const struct paddle_constants *paddle_2) {
+    return update_block(batch, i, dt, paddle_1, paddle_2);
+}
+#endif
@@ -0,0 +1,255 @@
+#pragma once
+#include "batch.h"
+
+// The step of a block of lanes of a batch, included by batch.c to build it for
+// the instruction set of the build, and by batch_avx.c to build it for AVX.
+
+// The instruction set the build targets is used for the whole batch, unless
+// it's one where AVX is left for batch_avx.c to build the block step with on
+// its own, for update_sim_batch() to pick when the processor supports it.
+#if !defined(SIM_BATCH_NO_SIMD) && !defined(__AVX__) &&                       \
+    defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIM_BATCH_RUNTIME_AVX
+#endif
+
+#if !defined(SIM_BATCH_NO_SIMD) &&                                             \
+    (defined(__AVX__) ||                                                       \
+     (defined(SIM_BATCH_RUNTIME_AVX) && defined(SIM_BATCH_AVX_BLOCK)))
+#define SIM_BATCH_AVX
+#include <immintrin.h>
+#elif !defined(SIM_BATCH_NO_SIMD) &&                                           \
+    (defined(__SSE2__) || defined(_M_X64) ||                                   \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SIM_BATCH_SSE
+#include <emmintrin.h>
+#endif
+
+// The functions of the block step only get to use AVX where it's asked for.
+#if defined(SIM_BATCH_AVX) && !defined(__AVX__)
+#define BLOCK_TARGET __attribute__((target("avx")))
+#else
+#define BLOCK_TARGET
+#endif
+
+// The operations the tick is written with, on as many lanes at once as the
+// instruction set allows. Every one of them must produce exactly the same
+// result as the scalar code it replaces in sim.c. vkeep() returns the values
+// for which the mask is set and zero for the others.
+#if defined(SIM_BATCH_AVX)
+#define BLOCK_WIDTH 8
+typedef __m256 vfloat;
+typedef __m256 vmask;
+#define vset _mm256_set1_ps
+#define vload _mm256_loadu_ps
+#define vstore _mm256_storeu_ps
+#define vadd _mm256_add_ps
+#define vsub _mm256_sub_ps
+#define vmul _mm256_mul_ps
+#define vdiv _mm256_div_ps
+#define vmin _mm256_min_ps
+#define vmax _mm256_max_ps
+#define vlt(a, b) _mm256_cmp_ps((a), (b), _CMP_LT_OQ)
+#define vgt(a, b) _mm256_cmp_ps((a), (b), _CMP_GT_OQ)
+#define vand _mm256_and_ps
+#define vor _mm256_or_ps
+// Blending is left to and and andnot, which GCC otherwise turns into integer
+// operations that AVX doesn't have on 8 lanes and does one lane at a time.
+#define vselect(m, a, b)                                                       \
+    _mm256_or_ps(_mm256_and_ps((m), (a)), _mm256_andnot_ps((m), (b)))
+#define vkeep _mm256_and_ps
+#define vabs(x) _mm256_andnot_ps(_mm256_set1_ps(-0.0f), (x))
+#define vtrunc(x) _mm256_cvtepi32_ps(_mm256_cvttps_epi32(x))
+#define vbits _mm256_movemask_ps
+#elif defined(SIM_BATCH_SSE)
+#define BLOCK_WIDTH 4
+typedef __m128 vfloat;
+typedef __m128 vmask;
+#define vset _mm_set1_ps
+#define vload _mm_loadu_ps
+#define vstore _mm_storeu_ps
+#define vadd _mm_add_ps
+#define vsub _mm_sub_ps
+#define vmul _mm_mul_ps
+#define vdiv _mm_div_ps
+#define vmin _mm_min_ps
+#define vmax _mm_max_ps
+#define vlt _mm_cmplt_ps
+#define vgt _mm_cmpgt_ps
+#define vand _mm_and_ps
+#define vor _mm_or_ps
+#define vselect(m, a, b)                                                       \
+    _mm_or_ps(_mm_and_ps((m), (a)), _mm_andnot_ps((m), (b)))
+#define vkeep _mm_and_ps
+#define vabs(x) _mm_andnot_ps(_mm_set1_ps(-0.0f), (x))
+#define vtrunc(x) _mm_cvtepi32_ps(_mm_cvttps_epi32(x))
+#define vbits _mm_movemask_ps
+#else
+#define BLOCK_WIDTH 1
+typedef float vfloat;
+typedef int vmask;
+#define vset(x) (x)
+#define vload(p) (*(p))
+#define vstore(p, x) (*(p) = (x))
+#define vadd(a, b) ((a) + (b))
+#define vsub(a, b) ((a) - (b))
+#define vmul(a, b) ((a) * (b))
+#define vdiv(a, b) ((a) / (b))
+#define vmin fminf
+#define vmax fmaxf
+#define vlt(a, b) ((a) < (b))
+#define vgt(a, b) ((a) > (b))
+#define vand(a, b) ((a) & (b))
+#define vor(a, b) ((a) | (b))
+#define vselect(m, a, b) ((m) ? (a) : (b))
+#define vkeep(m, x) ((m) ? (x) : 0.0f)
+#define vabs fabsf
+#define vtrunc(x) ((float)(int)(x))
+#define vbits(m) (m)
+#endif
+
+// What the tick needs to know about a paddle, precomputed the same way as the
+// scalar code computes it.
+struct paddle_constants {
+    int no;
+    float x;
+    float w;
+    float max_y;
+    float center_y;
+    float half_h;
+    float ball_offset;
+    float max_speed;
+    float face_min_x; // of the half of the paddle facing the net
+    float face_max_x;
+};
+
+#if defined(SIM_BATCH_RUNTIME_AVX)
+int update_sim_batch_block_avx(struct sim_batch *batch, int i, float dt,
+                               const struct paddle_constants *paddle_1,
+                               const struct paddle_constants *paddle_2);
+#endif
+
+// The vector equivalent of set_ghost_velocity() for an active ghost, inlined
+// so that what depends on the paddle is folded into each call.
+BLOCK_TARGET static inline vfloat
+ghost_velocity(const struct paddle_constants *paddle, vfloat paddle_y,
+               vfloat ghost_speed, vfloat ghost_bias, vfloat ghost_idle_offset,
+               vfloat ball_x, vfloat ball_velocity_x, vfloat prediction_y,
+               vmask served) {
+    vfloat half_h = vset(paddle->half_h);
+
+    vfloat idle_target = vadd(vset(paddle->center_y), ghost_idle_offset);
+    vfloat bias = vmul(half_h, ghost_bias);
+    vfloat ball_target =
+        vadd(vsub(prediction_y, vset(paddle->ball_offset)), bias);
+    vfloat target = vselect(served, ball_target, idle_target);
+
+    vfloat ball_distance =
+        (paddle->no == 1)
+            ? vsub(vsub(ball_x, vset(paddle->x)), vset(paddle->w))
+            : vsub(vsub(vset(paddle->x), ball_x), vset(BALL_SIZE));
+    ball_distance = vabs(ball_distance);
+    vfloat cutoff = vset(LOGICAL_WIDTH / 1.1f);
+    vfloat ball_dist_factor =
+        vsub(vset(1.0f), vdiv(vmin(ball_distance, cutoff), cutoff));
+
+    vfloat target_offset = vsub(target, paddle_y);
+    vfloat target_dist_factor = vdiv(vmin(vabs(target_offset), half_h), half_h);
+
+    vmask opposite = (paddle->no == 1) ? vgt(ball_velocity_x, vset(0.0f))
+                                       : vlt(ball_velocity_x, vset(0.0f));
+    vfloat ball_dir_factor = vsub(vset(1.0f), vkeep(opposite, vset(0.5f)));
+
+    vfloat speed = vmul(
+        vmul(vmul(vmul(vset(paddle->max_speed), ghost_speed), ball_dist_factor),
+             target_dist_factor),
+        ball_dir_factor);
+
+    // sign() is given the offset converted to an integer, which truncates it.
+    vfloat truncated_offset = vtrunc(target_offset);
+    vfloat sign = vsub(vkeep(vgt(truncated_offset, vset(0.0f)), vset(1.0f)),
+                       vkeep(vlt(truncated_offset, vset(0.0f)), vset(1.0f)));
+    return vmul(sign, speed);
+}
+
+// Return the lanes whose ball sweeps over the half of the paddle facing the
+// net during the tick, or comes close to it.
+BLOCK_TARGET static inline vmask
+is_near_paddle(const struct paddle_constants *paddle, vfloat ball_x,
+               vfloat moved_ball_x) {
+    vfloat margin = vset(1.0f);
+    return vand(vlt(vmin(ball_x, moved_ball_x),
+                    vadd(vset(paddle->face_max_x), margin)),
+                vgt(vadd(vmax(ball_x, moved_ball_x), vset(BALL_SIZE)),
+                    vsub(vset(paddle->face_min_x), margin)));
+}
+
+// Step the lanes starting at the given index, the vector equivalent of
+// update_ghosts() followed by update_sim(), and return those left for
+// check_lane(), one bit per lane.
+BLOCK_TARGET static inline int
+update_block(struct sim_batch *batch, int i, float dt,
+             const struct paddle_constants *paddle_1,
+             const struct paddle_constants *paddle_2) {
+    vfloat zero = vset(0.0f);
+    vfloat ball_size = vset(BALL_SIZE);
+    vfloat max_ball_y = vset(LOGICAL_HEIGHT - (float)BALL_SIZE);
+    vfloat step = vset(dt);
+
+    vfloat paddle_1_y = vload(batch->paddle_1_y + i);
+    vfloat paddle_2_y = vload(batch->paddle_2_y + i);
+    vfloat ball_x = vload(batch->ball_x + i);
+    vfloat ball_y = vload(batch->ball_y + i);
+    vfloat ball_velocity_x = vload(batch->ball_velocity_x + i);
+    vfloat ball_velocity_y = vload(batch->ball_velocity_y + i);
+    vfloat prediction_y = vload(batch->prediction_y + i);
+    vmask served = vgt(vload(batch->served + i), zero);
+
+    vfloat paddle_1_velocity = ghost_velocity(
+        paddle_1, paddle_1_y, vload(batch->ghost_1_speed + i),
+        vload(batch->ghost_1_bias + i), vload(batch->ghost_1_idle_offset + i),
+        ball_x, ball_velocity_x, prediction_y, served);
+    vfloat paddle_2_velocity = ghost_velocity(
+        paddle_2, paddle_2_y, vload(batch->ghost_2_speed + i),
+        vload(batch->ghost_2_bias + i), vload(batch->ghost_2_idle_offset + i),
+        ball_x, ball_velocity_x, prediction_y, served);
+
+    paddle_1_y =
+        vmax(zero, vmin(vadd(paddle_1_y, vmul(paddle_1_velocity, step)),
+                        vset(paddle_1->max_y)));
+    paddle_2_y =
+        vmax(zero, vmin(vadd(paddle_2_y, vmul(paddle_2_velocity, step)),
+                        vset(paddle_2->max_y)));
+
+    // The ball moves once served, as if it ran into nothing. Adding zero to
+    // the position of a ball that isn't served leaves it as it is, short of
+    // the sign of a zero.
+    vfloat ball_step = vkeep(served, step);
+    vfloat moved_ball_x = vadd(ball_x, vmul(ball_velocity_x, ball_step));
+    vfloat moved_ball_y = vadd(ball_y, vmul(ball_velocity_y, ball_step));
+
+    // Lanes where the ball may have run into a wall or a paddle, or got
+    // missed, are rare, so their ball is left where it was for the scalar code
+    // to move. Being near enough is all it takes, the scalar code knows
+    // better. A ball past the face of a paddle can't run into it anymore, and
+    // only needs the scalar code again once it leaves the court.
+    vfloat margin = vset(1.0f);
+    vmask near_wall = vor(vlt(moved_ball_y, margin),
+                          vgt(moved_ball_y, vsub(max_ball_y, margin)));
+    vmask near_paddle = vor(is_near_paddle(paddle_1, ball_x, moved_ball_x),
+                            is_near_paddle(paddle_2, ball_x, moved_ball_x));
+    vmask missed =
+        vor(vlt(vadd(moved_ball_x, ball_size), margin),
+            vgt(moved_ball_x, vset(LOGICAL_WIDTH - 1.0f)));
+    vmask contact = vand(served, vor(vor(near_wall, near_paddle), missed));
+    ball_x = vselect(contact, ball_x, moved_ball_x);
+    ball_y = vselect(contact, ball_y, moved_ball_y);
+
+    vstore(batch->paddle_1_y + i, paddle_1_y);
+    vstore(batch->paddle_1_velocity + i, paddle_1_velocity);
+    vstore(batch->paddle_2_y + i, paddle_2_y);
+    vstore(batch->paddle_2_velocity + i, paddle_2_velocity);
+    vstore(batch->ball_x + i, ball_x);
+    vstore(batch->ball_y + i, ball_y);
+
+    return vbits(contact);
+}
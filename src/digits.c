@@ -8,7 +8,7 @@ static const float DIGIT_HALF_WIDTH = 0.4f; // determ. by the DIGITS points
 static const float DIGIT_LINE_SPREAD_FACTOR = 0.3f;
 
 struct points {
-    SDL_FPoint list[POINTS_LIST_MAX_LENGTH];
+    struct vec2 list[POINTS_LIST_MAX_LENGTH];
     int list_length;
 };
 
@@ -110,15 +110,15 @@ static float rendered_digit_width(int height) {
 }
 
 // The top-left corner of the digit will be equal to given position.
-static void render_digit(struct renderer_wrapper renderer, SDL_FPoint position,
+static void render_digit(struct draw_list *list, struct vec2 position,
                          int height, int digit) {
     float scale_factor = height / 2.0f;
     float line_spread = scale_factor * DIGIT_LINE_SPREAD_FACTOR;
 
     struct points points = DIGITS[digit % DIGITS_LENGTH];
     for (int i = 0; i < points.list_length; i += 2) {
-        SDL_FPoint p1 = points.list[i];
-        SDL_FPoint p2 = points.list[(i + 1) % points.list_length];
+        struct vec2 p1 = points.list[i];
+        struct vec2 p2 = points.list[(i + 1) % points.list_length];
 
         p1.x *= scale_factor;
         p2.x *= scale_factor;
@@ -130,25 +130,24 @@ static void render_digit(struct renderer_wrapper renderer, SDL_FPoint position,
         p1.y += position.y + scale_factor - (line_spread / 2.0f);
         p2.y += position.y + scale_factor - (line_spread / 2.0f);
 
-        SDL_FRect rect = {
+        struct rect rect = {
             .x = p1.x,
             .y = p1.y,
             .w = line_spread + (p2.x - p1.x),
             .h = line_spread + (p2.y - p1.y),
         };
-        rect = renderer_wrapper_scale_frect(renderer, rect);
-        SDL_RenderFillRectF(renderer.renderer, &rect);
+        draw_rect(list, rect);
     }
 }
 
 // The top-right corner of the rendered digits will be equal to given position.
-void render_digits(struct renderer_wrapper renderer, SDL_FPoint position,
-                   int height, int number) {
+void render_digits(struct draw_list *list, struct vec2 position, int height,
+                   int number) {
     float width = rendered_digit_width(height);
     do {
         int digit = number % 10;
         position.x -= width;
-        render_digit(renderer, position, height, digit);
+        render_digit(list, position, height, digit);
         position.x -= width; // gap
     } while ((number /= 10) != 0);
 }
@@ -1,8 +1,6 @@
 #pragma once
 
-#include <SDL.h>
+#include "draw.h"
 
-#include "renderer.h"
-
-void render_digits(struct renderer_wrapper renderer, SDL_FPoint position,
-                   int height, int number);
+void render_digits(struct draw_list *list, struct vec2 position, int height,
+                   int number);
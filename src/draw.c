@@ -0,0 +1,39 @@
+#include "draw.h"
+
+#include <stdbool.h>
+
+static bool colors_equal(struct color a, struct color b) {
+    return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+// Start a new frame filled with the given color.
+void clear_draw_list(struct draw_list *list, struct color color) {
+    list->clear_color = color;
+    list->colors_length = 0;
+    list->rects_length = 0;
+    set_draw_color(list, color);
+}
+
+// Set the color of the rectangles drawn next. Colors past the maximum share
+// the last one.
+void set_draw_color(struct draw_list *list, struct color color) {
+    for (int i = 0; i < list->colors_length; i++) {
+        if (colors_equal(list->colors[i], color)) {
+            list->color = i;
+            return;
+        }
+    }
+    if (list->colors_length < DRAW_LIST_MAX_COLORS) {
+        list->colors[list->colors_length++] = color;
+    }
+    list->color = list->colors_length - 1;
+}
+
+// Rectangles past the maximum are dropped.
+void draw_rect(struct draw_list *list, struct rect rect) {
+    if (list->rects_length < DRAW_LIST_MAX_RECTS) {
+        list->rects[list->rects_length] = rect;
+        list->rect_colors[list->rects_length] = list->color;
+        list->rects_length++;
+    }
+}
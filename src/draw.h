@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+
+#include "sim.h"
+
+// A frame described as a list of filled rectangles in logical coordinates,
+// meant to be handed over to a renderer all at once so that it can draw each
+// run of rectangles of the same colour with a single call. The rectangles are
+// drawn in their order, the later ones over the earlier ones, by every
+// renderer. Nothing in here may depend on SDL.
+
+#define DRAW_LIST_MAX_RECTS 512
+#define DRAW_LIST_MAX_COLORS 16
+
+struct color {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t a;
+};
+
+struct draw_list {
+    struct color clear_color;
+    struct color colors[DRAW_LIST_MAX_COLORS];
+    int colors_length;
+    int color; // index of the color new rectangles are drawn with
+    struct rect rects[DRAW_LIST_MAX_RECTS];
+    uint8_t rect_colors[DRAW_LIST_MAX_RECTS];
+    int rects_length;
+};
+
+void clear_draw_list(struct draw_list *list, struct color color);
+void set_draw_color(struct draw_list *list, struct color color);
+void draw_rect(struct draw_list *list, struct rect rect);
@@ -3,106 +3,89 @@
 #include <stdbool.h>
 
 #include "digits.h"
+#include "draw.h"
 #include "math.h"
 #include "renderer.h"
+#include "rewind.h"
+#include "scene.h"
+#include "sim.h"
 #include "tonegen.h"
 
-extern const int LOGICAL_WIDTH;
-extern const int LOGICAL_HEIGHT;
+#define INPUT_BUFFER_LENGTH 256 // must be a power of two
 
-struct ghost {
-    int idle_offset;
-    float speed;
-    float bias;
-    bool active;
-    float velocity;
-};
-
-struct paddle {
-    int no;
-    SDL_FRect rect;
-    float velocity;
-    float max_speed;
-    int score;
-};
-
-struct ball {
-    SDL_FRect rect;
-    SDL_FPoint velocity;
-    bool served;
-    uint32_t serve_time;
-    bool horizontal_bounce;
-};
-
-struct events {
-    bool paddle_missed_ball;
-    bool ball_hit_paddle;
-    bool ball_hit_wall;
+// The input events received since the last tick, in the order they were
+// received, each waiting for the tick it happened during to be simulated.
+struct input_buffer {
+    SDL_Event events[INPUT_BUFFER_LENGTH];
+    uint32_t head; // wraps around, like the tail
+    uint32_t tail;
 };
 
 struct player_input {
     SDL_GameController *controller;
+    SDL_JoystickID controller_id; // of the controller, when there is one
     SDL_TouchID touch_id;
     SDL_FingerID finger_id;
     int finger_y;
     bool finger_down;
     uint32_t last_input_timestamp;
+    // The keys and the buttons of the D-pad moving the paddle, as of the
+    // last event applied.
+    bool key_up;
+    bool key_down;
+    bool button_up;
+    bool button_down;
+    // Pressed since the last tick, even if released since, so that presses
+    // shorter than a tick still move the paddle.
+    bool up_tapped;
+    bool down_tapped;
+    // The axes of the controller with their dead zones taken out, from -1 to
+    // 1 for the stick and from 0 to 1 for the triggers.
+    float stick_y;
+    float left_trigger;
+    float right_trigger;
 };
 
 struct game {
     SDL_Window *window;
     bool cheats_enabled;
     struct tonegen tonegen;
-    struct paddle paddle_1;
-    struct paddle paddle_2;
-    float ghosts_sharpness;
-    struct ghost ghost_1;
-    struct ghost ghost_2;
-    struct ball ball;
-    struct ball ghost_ball;
-    int max_score;
+    struct sim sim;
     struct player_input player_1_input;
     struct player_input player_2_input;
+    struct input_buffer input_buffer;
+    // The fractions of the travel of the sticks and the triggers ignored
+    // around their rest position.
+    float stick_deadzone;
+    float trigger_deadzone;
     bool first_player_input;
     uint32_t last_center_finger_down_timestamp;
     SDL_FingerID last_center_finger_down_finger_id;
     bool paused;
     bool debug_mode;
-    double time;
-    bool round_over;
-    uint32_t round_restart_time;
-    struct events events;
+    // The window may only be changed by the thread that created it, so a game
+    // running on another thread counts the times it wants to toggle
+    // fullscreen for that thread to do it.
+    bool window_on_other_thread;
+    SDL_atomic_t fullscreen_toggles;
+    // The last ticks, kept to replay the last rally while the simulation
+    // waits.
+    struct rewind_buffer rewind;
+    struct instant_replay instant_replay;
 };
 
-struct game make_game(SDL_Window *window, bool cheats_enabled);
+struct game make_game(SDL_Window *window, bool cheats_enabled, uint64_t seed);
 void check_controller_added_event(struct game *game, SDL_Event event);
 void check_controller_removed_event(struct game *game, SDL_Event event);
 void check_finger_down_event(struct game *game, SDL_Event event);
 void check_finger_up_event(struct game *game, SDL_Event event);
 void check_finger_motion_event(struct game *game, SDL_Event event);
 void check_keydown_event(struct game *game, SDL_Event event);
-struct paddle make_paddle(int no);
-struct ghost make_ghost(float ghosts_sharpness);
-struct ball make_ball(int paddle_no, bool round_over, double t);
-struct ball make_ghost_ball(struct ball ball, float ghosts_sharpness);
+void queue_input_event(struct game *game, SDL_Event event);
+void apply_input_events(struct game *game, uint32_t time);
+void apply_fullscreen_toggles(struct game *game);
 void check_paddle_controls(struct paddle *paddle, struct ghost *ghost,
                            struct player_input *input);
 void check_player_activity(struct game *game, struct player_input input,
                            struct ghost *ghost);
-void set_ghost_velocity(struct ghost *ghost, struct paddle paddle,
-                        struct ball ball);
-void update_paddle(struct paddle *paddle, double dt);
-void update_ball(struct ball *ball, double dt, double t);
-void check_ball_hit_wall(struct game *game);
-void check_paddle_missed_ball(struct game *game);
-void check_paddle_hit_ball(struct game *game);
-void check_round_over(struct game *game);
-void check_round_restart_timeout(struct game *game);
 void check_game_events(struct game *game);
-void render_score(struct renderer_wrapper renderer, struct paddle paddle);
-void render_net(struct renderer_wrapper renderer);
-void render_paddle(struct renderer_wrapper renderer, struct game *game,
-                   struct paddle paddle);
-void render_ball(struct renderer_wrapper renderer, struct ball ball);
-void debug_render_ghost_ball(struct renderer_wrapper renderer,
-                             struct ball ball);
@@ -0,0 +1,100 @@
+#include "latency.h"
+
+#include <stdlib.h>
+
+#define MAX_PEEKED_EVENTS 64
+
+// Return whether an axis moved past its dead zone, only the axes that move
+// the paddles counting.
+static bool is_axis_input(const struct input_latency *latency,
+                          SDL_Event event) {
+    float value = abs(event.caxis.value) / (float)SDL_JOYSTICK_AXIS_MAX;
+    switch (event.caxis.axis) {
+    case SDL_CONTROLLER_AXIS_LEFTY:
+        return value > latency->stick_deadzone;
+    case SDL_CONTROLLER_AXIS_TRIGGERLEFT:
+    case SDL_CONTROLLER_AXIS_TRIGGERRIGHT:
+        return value > latency->trigger_deadzone;
+    }
+    return false;
+}
+
+static bool is_input_event(const struct input_latency *latency,
+                           SDL_Event event) {
+    switch (event.type) {
+    case SDL_KEYDOWN:
+        return !event.key.repeat;
+    case SDL_CONTROLLERAXISMOTION:
+        return is_axis_input(latency, event);
+    case SDL_KEYUP:
+    case SDL_CONTROLLERBUTTONDOWN:
+    case SDL_CONTROLLERBUTTONUP:
+    case SDL_FINGERDOWN:
+    case SDL_FINGERUP:
+    case SDL_FINGERMOTION:
+        return true;
+    }
+    return false;
+}
+
+// Note an input event, unless it was already noted while it was still queued.
+// Inputs are left out while too many are waiting to be presented.
+void note_input_event(struct input_latency *latency, SDL_Event event) {
+    if (!latency->enabled || !is_input_event(latency, event) ||
+        event.common.timestamp <= latency->last_timestamp) {
+        return;
+    }
+    latency->last_timestamp = event.common.timestamp;
+    if (latency->pending_head - latency->pending_tail < MAX_PENDING_INPUTS) {
+        latency->pending[latency->pending_head++ &
+                         (MAX_PENDING_INPUTS - 1)] = event.common.timestamp;
+    }
+}
+
+// Note the input events pumped into the queue but not handled yet, whose
+// effect may be sampled before they are.
+void note_queued_input_events(struct input_latency *latency) {
+    if (!latency->enabled) {
+        return;
+    }
+    SDL_Event events[MAX_PEEKED_EVENTS];
+    int length = SDL_PeepEvents(events, MAX_PEEKED_EVENTS, SDL_PEEKEVENT,
+                                SDL_FIRSTEVENT, SDL_LASTEVENT);
+    for (int i = 0; i < length; i++) {
+        note_input_event(latency, events[i]);
+    }
+}
+
+// Note that a frame was just presented, drawn from a state simulated with the
+// input events up to the given time, as given by SDL_GetTicks(). The inputs
+// after it are left for a later frame.
+void note_present(struct input_latency *latency, uint32_t input_time) {
+    uint32_t now = SDL_GetTicks();
+    for (; latency->pending_tail != latency->pending_head;
+         latency->pending_tail++) {
+        uint32_t timestamp =
+            latency->pending[latency->pending_tail & (MAX_PENDING_INPUTS - 1)];
+        if (!SDL_TICKS_PASSED(input_time, timestamp)) {
+            break;
+        }
+        uint32_t time = now - timestamp;
+        if (latency->count == 0 || time < latency->min) {
+            latency->min = time;
+        }
+        if (time > latency->max) {
+            latency->max = time;
+        }
+        latency->sum += time;
+        latency->count++;
+    }
+}
+
+void report_input_latency(const struct input_latency *latency) {
+    if (!latency->enabled || latency->count == 0) {
+        return;
+    }
+    SDL_Log("Input latency over %ld inputs: %.1f ms mean, %u ms min, %u ms "
+            "max",
+            latency->count, latency->sum / latency->count, latency->min,
+            latency->max);
+}
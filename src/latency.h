@@ -0,0 +1,30 @@
+#pragma once
+
+#include <SDL.h>
+#include <stdbool.h>
+
+#define MAX_PENDING_INPUTS 64 // must be a power of two
+
+// Input to photon latency: the time between an input event and the end of
+// the presentation of the first frame drawn from a state simulated with it.
+struct input_latency {
+    bool enabled;
+    // The timestamps of the inputs noted but not presented yet, oldest first.
+    uint32_t pending[MAX_PENDING_INPUTS];
+    uint32_t pending_head; // wraps around, like the tail
+    uint32_t pending_tail;
+    uint32_t last_timestamp; // of the last input noted
+    long count;
+    double sum;   // in ms
+    uint32_t min; // in ms
+    uint32_t max; // in ms
+    // The fractions of the travel of the axes within which their motion is
+    // noise rather than input, as for the game.
+    float stick_deadzone;
+    float trigger_deadzone;
+};
+
+void note_input_event(struct input_latency *latency, SDL_Event event);
+void note_queued_input_events(struct input_latency *latency);
+void note_present(struct input_latency *latency, uint32_t input_time);
+void report_input_latency(const struct input_latency *latency);
@@ -1,13 +1,23 @@
 #include <SDL.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #endif
 
 #include "game.h"
+#include "latency.h"
 #include "math.h"
+#include "net.h"
+#include "pacer.h"
+#include "record.h"
 #include "renderer.h"
+#include "rollback.h"
+#include "simthread.h"
+#include "startup.h"
+#include "timings.h"
 #include "tonegen.h"
 
 #ifndef DEBUGGING
@@ -17,45 +27,135 @@
 const int WINDOW_WIDTH = 800;
 const int WINDOW_HEIGHT = 600;
 
+const int DEFAULT_TICK_RATE = 120; // in Hz
+
+// The frame rate while ghosts play against each other without any player.
+const int DEFAULT_ATTRACT_FRAME_RATE = 30; // in Hz
+
+// How long to sleep waiting for events while nothing moves on the screen.
+const int IDLE_TIMEOUT = 250; // in ms
+
+// The longest stretch of time the simulation will catch up on in a single
+// frame. Anything beyond it is dropped so that a slow frame can't cause an
+// ever growing number of ticks to be simulated on the following frames.
+const double MAX_FRAME_TIME = 0.25; // in seconds
+
+// The input events of each kind taken from the queue at once by the late
+// latch.
+#define MAX_LATCHED_EVENTS 64
+
+struct options {
+    int tick_rate;
+    int attract_frame_rate; // or 0 to render every frame
+    int audio_period;       // in samples
+    bool measure_audio_latency;
+    bool measure_input_latency;
+    bool measure_startup;
+    bool late_latch;
+    bool sim_thread;
+    int stick_deadzone;   // in percent
+    int trigger_deadzone; // in percent
+    bool frame_pacing;
+    int refresh_rate; // paced at, or 0 when uncapped
+    bool vsync;
+    uint64_t seed;
+    const char *record_path; // or NULL
+    int netplay_player;      // or 0 to play on this machine only
+    int port;
+    const char *peer;
+    int net_delay; // in ms
+    int net_loss;  // in percent
+};
+
 struct context {
     struct game game;
+    struct sim previous_sim; // as of the tick before the last one
     struct renderer_wrapper renderer;
-    SDL_AudioDeviceID audio_device_id;
+    struct draw_list draw_list;
+    // The scores drawn on the background, or -1 before it is first drawn.
+    int background_score_1;
+    int background_score_2;
+    struct startup startup;
     bool quit_requested;
     uint64_t current_time;
+    double tick_duration; // in seconds
+    double accumulator;   // simulation time yet to be ticked, in seconds
+    double attract_frame_duration; // in seconds, or 0
+    bool window_visible;
+    bool redraw_requested; // by an event received while idle
+    struct frame_timings timings;
+    struct input_latency input_latency;
+    struct frame_pacer pacer; // unless disabled
+    // Sample the controls again right before the last tick of a frame, and
+    // draw the paddles of the players where they are rather than
+    // interpolated.
+    bool late_latch;
+    struct recorder recorder;
+    bool recording;
+    // The simulation of a netplay session, which starts when player 2
+    // receives the first packet of player 1.
+    struct net_link *net_link; // or NULL without netplay
+    struct rollback rollback;
+    bool netplay_started;
+    // The simulation stepped on a thread of its own, the game only being
+    // drawn from its snapshots here.
+    struct sim_thread sim_thread;
+    int64_t sim_thread_ticks; // of the last snapshot taken
 };
 
+static bool parse_options(int argc, char *argv[], struct options *options);
+static int get_idle_timeout(struct context *ctx);
+static void check_window_event(struct context *ctx, SDL_Event event);
+static void check_event(struct context *ctx, SDL_Event event);
+static void time_phase(struct context *ctx, enum frame_phase phase,
+                       uint64_t *start_time);
+static void latch_controls(struct context *ctx);
+static void run_ticks(struct context *ctx, uint64_t *phase_start_time);
+static float get_netplay_velocity(struct game *game, struct sim *sim,
+                                  int no);
+static void run_netplay_ticks(struct context *ctx, uint64_t *phase_start_time);
+static void update_game(struct context *ctx, double frame_time,
+                        uint64_t *phase_start_time, struct sim_snapshot *frame);
+static void take_sim_snapshot(struct context *ctx, struct sim_snapshot *frame);
 void main_loop(void *arg);
 
 int main(int argc, char *argv[]) {
-    // Suppress unused variable warnings, SDL requires that main accept argc and
-    // argv when using MSVC or MinGW.
-    (void)argc;
-    (void)argv;
-
-    srand(time(NULL));
+    struct startup startup = make_startup(false);
+    struct options options = {
+        .tick_rate = DEFAULT_TICK_RATE,
+        .attract_frame_rate = DEFAULT_ATTRACT_FRAME_RATE,
+        .audio_period = TONEGEN_DEFAULT_PERIOD,
+        .stick_deadzone = 15,
+        .trigger_deadzone = 5,
+        .vsync = true,
+        .seed = time(NULL),
+    };
+    if (!parse_options(argc, argv, &options)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Usage: %s [--tick-rate HZ] [--attract-frame-rate HZ] "
+                     "[--audio-period N] [--measure-audio-latency] "
+                     "[--measure-input-latency] [--measure-startup] "
+                     "[--late-latch] [--sim-thread] "
+                     "[--stick-deadzone PERCENT] [--trigger-deadzone PERCENT] "
+                     "[--frame-pacing HZ|uncapped] [--no-vsync] [--seed N] "
+                     "[--record PATH] [--netplay 1|2 --port PORT "
+                     "--peer HOST:PORT [--net-delay MS] [--net-loss PERCENT]]",
+                     argv[0]);
+        return EXIT_FAILURE;
+    }
 
 #if DEBUGGING
     SDL_LogSetPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_DEBUG);
 #endif
 
-    uint32_t flags = SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_GAMECONTROLLER;
-    if (SDL_Init(flags) < 0) {
+    // Only the video is initialized before the first frame is presented.
+    startup.measure = options.measure_startup;
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                      "Couldn't initialize SDL: %s", SDL_GetError());
         return EXIT_FAILURE;
     }
 
-    SDL_AudioDeviceID audio_device_id =
-        SDL_OpenAudioDevice(NULL, 0, &TONEGEN_AUDIO_SPEC, NULL, 0);
-    if (audio_device_id == 0) {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                     "Couldn't open an audio device: %s", SDL_GetError());
-    }
-
-    // Unpause the audio device because it is paused by default.
-    SDL_PauseAudioDevice(audio_device_id, 0);
-
     // Create a hidden window so it may only be shown after the game is mostly
     // initialized.
     SDL_Window *window = SDL_CreateWindow(
@@ -67,24 +167,94 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
-    SDL_Renderer *renderer =
-        SDL_CreateRenderer(window, -1, SDL_RENDERER_PRESENTVSYNC);
+    SDL_Renderer *renderer = SDL_CreateRenderer(
+        window, -1, options.vsync ? SDL_RENDERER_PRESENTVSYNC : 0);
     if (renderer == NULL) {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                      "Couldn't create renderer: %s", SDL_GetError());
         return EXIT_FAILURE;
     }
 
+    note_video_started(&startup);
+
     struct context ctx = {
-        .game = make_game(window, DEBUGGING),
+        .game = make_game(window, DEBUGGING, options.seed),
         .renderer =
             make_renderer_wrapper(renderer, LOGICAL_WIDTH, LOGICAL_HEIGHT),
-        .audio_device_id = audio_device_id,
+        .background_score_1 = -1,
+        .background_score_2 = -1,
         .current_time = SDL_GetPerformanceCounter(),
+        .tick_duration = 1.0 / options.tick_rate,
+        .window_visible = true,
+        .input_latency = {.enabled = options.measure_input_latency},
+        .late_latch = options.late_latch,
+        .startup = startup,
     };
+    if (options.attract_frame_rate > 0) {
+        ctx.attract_frame_duration = 1.0 / options.attract_frame_rate;
+    }
+    ctx.game.stick_deadzone = options.stick_deadzone / 100.0f;
+    ctx.game.trigger_deadzone = options.trigger_deadzone / 100.0f;
+    ctx.input_latency.stick_deadzone = ctx.game.stick_deadzone;
+    ctx.input_latency.trigger_deadzone = ctx.game.trigger_deadzone;
+    if (options.frame_pacing) {
+        ctx.pacer = make_frame_pacer(options.refresh_rate, options.vsync);
+    }
+
+    if (options.netplay_player != 0) {
+        ctx.net_link = open_net_link(options.port, options.peer,
+                                     options.net_delay / 1000.0,
+                                     options.net_loss / 100.0f);
+        if (ctx.net_link == NULL) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Couldn't open port %d to %s", options.port,
+                         options.peer);
+            return EXIT_FAILURE;
+        }
+        // The seed and the tick rate of player 1 are the ones of the session.
+        if (options.netplay_player == 1) {
+            init_rollback(&ctx.rollback, options.seed, options.tick_rate, 1);
+            ctx.netplay_started = true;
+            ctx.game.sim = ctx.rollback.sim;
+        }
+    }
+
+    // The ticks of netplay may be rolled back, so only the ones of a game on
+    // this machine are kept.
+    if (ctx.net_link == NULL &&
+        !init_rewind_buffer(&ctx.game.rewind,
+                            REWIND_DURATION * options.tick_rate)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Couldn't allocate the rewind buffer");
+    }
+
+    if (options.record_path != NULL) {
+        ctx.recording =
+            open_recorder(&ctx.recorder, options.record_path, &ctx.game.sim,
+                          options.seed, options.tick_rate);
+        if (!ctx.recording) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Couldn't create recording %s", options.record_path);
+        }
+    }
+
+    // The audio device is only opened once the game is where it will stay,
+    // while the first frame is drawn.
+    ctx.game.tonegen.measure_latency = options.measure_audio_latency;
+    start_audio(&ctx.startup, &ctx.game.tonegen, options.audio_period);
+    ctx.previous_sim = ctx.game.sim;
 
     SDL_AddEventWatch(renderer_wrapper_event_watch, &ctx.renderer);
 
+    if (options.sim_thread &&
+        !start_sim_thread(&ctx.sim_thread, &ctx.game, ctx.tick_duration,
+                          ctx.recording ? &ctx.recorder : NULL)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Couldn't start the simulation thread: %s",
+                     SDL_GetError());
+        return EXIT_FAILURE;
+    }
+
     SDL_ShowWindow(window);
 
 #ifdef __EMSCRIPTEN__
@@ -95,107 +265,565 @@ int main(int argc, char *argv[]) {
     }
 #endif
 
+    stop_sim_thread(&ctx.sim_thread);
+
     SDL_GameControllerClose(ctx.game.player_1_input.controller);
     SDL_GameControllerClose(ctx.game.player_2_input.controller);
 
+    destroy_renderer_wrapper(&ctx.renderer);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
 
-    SDL_CloseAudioDevice(audio_device_id);
+    SDL_CloseAudioDevice(finish_startup(&ctx.startup));
+    report_tonegen_latency(&ctx.game.tonegen);
+    report_input_latency(&ctx.input_latency);
+    report_frame_pacer(&ctx.pacer);
+
+    if (ctx.recording && !close_recorder(&ctx.recorder)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Couldn't write recording %s", options.record_path);
+    }
+    if (ctx.net_link != NULL) {
+        close_net_link(ctx.net_link);
+    }
+    destroy_rewind_buffer(&ctx.game.rewind);
 
     SDL_Quit();
 
     return EXIT_SUCCESS;
 }
 
-void main_loop(void *arg) {
-    struct context *ctx = arg;
+static bool parse_options(int argc, char *argv[], struct options *options) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc) {
+            options->tick_rate = strtol(argv[++i], NULL, 10);
+            if (options->tick_rate <= 0) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--attract-frame-rate") == 0 &&
+                   i + 1 < argc) {
+            options->attract_frame_rate = strtol(argv[++i], NULL, 10);
+            if (options->attract_frame_rate < 0) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--audio-period") == 0 && i + 1 < argc) {
+            // SDL wants a power of two.
+            options->audio_period = strtol(argv[++i], NULL, 10);
+            if (options->audio_period < TONEGEN_MIN_PERIOD ||
+                options->audio_period > TONEGEN_MAX_PERIOD ||
+                (options->audio_period & (options->audio_period - 1)) != 0) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--measure-audio-latency") == 0) {
+            options->measure_audio_latency = true;
+        } else if (strcmp(argv[i], "--measure-input-latency") == 0) {
+            options->measure_input_latency = true;
+        } else if (strcmp(argv[i], "--measure-startup") == 0) {
+            options->measure_startup = true;
+        } else if (strcmp(argv[i], "--late-latch") == 0) {
+            options->late_latch = true;
+        } else if (strcmp(argv[i], "--sim-thread") == 0) {
+            options->sim_thread = true;
+        } else if (strcmp(argv[i], "--stick-deadzone") == 0 &&
+                   i + 1 < argc) {
+            options->stick_deadzone = strtol(argv[++i], NULL, 10);
+            if (options->stick_deadzone < 0 || options->stick_deadzone >= 100) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--trigger-deadzone") == 0 &&
+                   i + 1 < argc) {
+            options->trigger_deadzone = strtol(argv[++i], NULL, 10);
+            if (options->trigger_deadzone < 0 ||
+                options->trigger_deadzone >= 100) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--frame-pacing") == 0 && i + 1 < argc) {
+            // Drawing as fast as possible doesn't wait for the refreshes.
+            options->frame_pacing = true;
+            if (strcmp(argv[++i], "uncapped") == 0) {
+                options->refresh_rate = 0;
+                options->vsync = false;
+            } else {
+                options->refresh_rate = strtol(argv[i], NULL, 10);
+                if (options->refresh_rate <= 0 ||
+                    options->refresh_rate > 1000) {
+                    return false;
+                }
+            }
+        } else if (strcmp(argv[i], "--no-vsync") == 0) {
+            options->vsync = false;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            options->seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            options->record_path = argv[++i];
+        } else if (strcmp(argv[i], "--netplay") == 0 && i + 1 < argc) {
+            options->netplay_player = strtol(argv[++i], NULL, 10);
+            if (options->netplay_player != 1 && options->netplay_player != 2) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            options->port = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--peer") == 0 && i + 1 < argc) {
+            options->peer = argv[++i];
+        } else if (strcmp(argv[i], "--net-delay") == 0 && i + 1 < argc) {
+            options->net_delay = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--net-loss") == 0 && i + 1 < argc) {
+            options->net_loss = strtol(argv[++i], NULL, 10);
+        } else {
+            return false;
+        }
+    }
+    // Netplay only records the inputs of the players, which don't go through
+    // the recorder.
+    if (options->netplay_player != 0 &&
+        (options->port <= 0 || options->peer == NULL ||
+         options->net_delay < 0 || options->net_loss < 0 ||
+         options->net_loss >= 100 || options->record_path != NULL)) {
+        return false;
+    }
+#ifdef __EMSCRIPTEN__
+    // The browser calls the main loop on the refreshes.
+    if (options->frame_pacing || !options->vsync) {
+        return false;
+    }
+#endif
+    // The simulation thread samples the controls from the events at every
+    // tick, and can't be rolled back. The browser has no threads to give it.
+    if (options->sim_thread) {
+#ifdef __EMSCRIPTEN__
+        return false;
+#endif
+        if (options->late_latch || options->netplay_player != 0) {
+            return false;
+        }
+    }
+    return true;
+}
 
+// Return how long to block waiting for an event before the next frame, in ms.
+// The game sleeps while it is paused or can't be seen, and only renders at a
+// low frame rate while ghosts play against each other.
+static int get_idle_timeout(struct context *ctx) {
     struct game *game = &ctx->game;
 
-    uint64_t previous_time = ctx->current_time;
-    ctx->current_time = SDL_GetPerformanceCounter();
-    double frame_time = (ctx->current_time - previous_time) /
-                        (double)SDL_GetPerformanceFrequency();
+#ifdef __EMSCRIPTEN__
+    // The browser calls the main loop and throttles it when it is hidden.
+    return 0;
+#endif
 
-    SDL_Event event = {0};
-    while (SDL_PollEvent(&event) == 1) {
-        switch (event.type) {
-        case SDL_QUIT:
-            ctx->quit_requested = true;
-            break;
-        case SDL_KEYDOWN:
-            check_keydown_event(game, event);
-            break;
-        case SDL_FINGERDOWN:
-            check_finger_down_event(game, event);
-            break;
-        case SDL_FINGERUP:
-            check_finger_up_event(game, event);
-            break;
-        case SDL_FINGERMOTION:
-            check_finger_motion_event(game, event);
-            break;
-        case SDL_CONTROLLERDEVICEADDED:
-            check_controller_added_event(game, event);
-            break;
-        case SDL_CONTROLLERDEVICEREMOVED:
-            check_controller_removed_event(game, event);
-            break;
-        }
+    bool paused = game->paused;
+    const struct sim *sim = &game->sim;
+    if (ctx->sim_thread.thread != NULL) {
+        const struct sim_snapshot *snapshot =
+            get_sim_snapshot(&ctx->sim_thread);
+        paused = snapshot->paused;
+        sim = &snapshot->sim;
     }
 
-    check_player_activity(game, game->player_1_input, &game->ghost_1);
-    check_player_activity(game, game->player_2_input, &game->ghost_2);
+    if (paused || !ctx->window_visible) {
+        return IDLE_TIMEOUT;
+    }
+    if (ctx->attract_frame_duration > 0 && sim->ghost_1.active &&
+        sim->ghost_2.active) {
+        double elapsed = (SDL_GetPerformanceCounter() - ctx->current_time) /
+                         (double)SDL_GetPerformanceFrequency();
+        return fmax(ceil((ctx->attract_frame_duration - elapsed) * 1000), 0);
+    }
+    return 0;
+}
 
-    set_ghost_velocity(&game->ghost_1, game->paddle_1, game->ghost_ball);
-    set_ghost_velocity(&game->ghost_2, game->paddle_2, game->ghost_ball);
+static void check_window_event(struct context *ctx, SDL_Event event) {
+    switch (event.window.event) {
+    case SDL_WINDOWEVENT_HIDDEN:
+    case SDL_WINDOWEVENT_MINIMIZED:
+        ctx->window_visible = false;
+        break;
+    case SDL_WINDOWEVENT_SHOWN:
+    case SDL_WINDOWEVENT_RESTORED:
+    case SDL_WINDOWEVENT_MAXIMIZED:
+    case SDL_WINDOWEVENT_EXPOSED:
+        ctx->window_visible = true;
+        break;
+    }
+}
 
-    check_paddle_controls(&game->paddle_1, &game->ghost_1,
+// Handle an event, the ones moving the paddles being kept for the tick they
+// happened during. The events of the game are handled by the simulation
+// thread when there is one, and only the ones of the window here.
+static void check_event(struct context *ctx, SDL_Event event) {
+    struct game *game = &ctx->game;
+    ctx->redraw_requested = true;
+    note_input_event(&ctx->input_latency, event);
+
+    if (ctx->sim_thread.thread != NULL && event.type != SDL_QUIT &&
+        event.type != SDL_WINDOWEVENT) {
+        post_sim_thread_event(&ctx->sim_thread, event);
+        return;
+    }
+
+    switch (event.type) {
+    case SDL_QUIT:
+        ctx->quit_requested = true;
+        break;
+    case SDL_WINDOWEVENT:
+        check_window_event(ctx, event);
+        break;
+    case SDL_KEYDOWN:
+        check_keydown_event(game, event);
+        queue_input_event(game, event);
+        break;
+    case SDL_KEYUP:
+    case SDL_CONTROLLERAXISMOTION:
+    case SDL_CONTROLLERBUTTONDOWN:
+    case SDL_CONTROLLERBUTTONUP:
+    case SDL_FINGERDOWN:
+    case SDL_FINGERUP:
+    case SDL_FINGERMOTION:
+        queue_input_event(game, event);
+        break;
+    case SDL_CONTROLLERDEVICEADDED:
+        check_controller_added_event(game, event);
+        break;
+    case SDL_CONTROLLERDEVICEREMOVED:
+        check_controller_removed_event(game, event);
+        break;
+    }
+}
+
+// Add the time since the start time to a phase of the frame, and make the
+// current time the start time of the next phase.
+static void time_phase(struct context *ctx, enum frame_phase phase,
+                       uint64_t *start_time) {
+    uint64_t time = SDL_GetPerformanceCounter();
+    double frequency = SDL_GetPerformanceFrequency();
+    add_phase_time(&ctx->timings, phase, (time - *start_time) / frequency);
+    *start_time = time;
+}
+
+// Take the input events received since the start of the frame as late as
+// possible, for the last tick of the frame to be simulated with them.
+static void latch_controls(struct context *ctx) {
+    SDL_PumpEvents();
+    note_queued_input_events(&ctx->input_latency);
+    const uint32_t ranges[][2] = {
+        {SDL_KEYDOWN, SDL_KEYUP},
+        {SDL_CONTROLLERAXISMOTION, SDL_CONTROLLERBUTTONUP},
+        {SDL_FINGERDOWN, SDL_FINGERMOTION},
+    };
+    for (int i = 0; i < 3; i++) {
+        SDL_Event events[MAX_LATCHED_EVENTS];
+        int length = SDL_PeepEvents(events, MAX_LATCHED_EVENTS, SDL_GETEVENT,
+                                    ranges[i][0], ranges[i][1]);
+        for (int j = 0; j < length; j++) {
+            check_event(ctx, events[j]);
+        }
+    }
+    apply_input_events(&ctx->game, SDL_GetTicks());
+}
+
+static void check_paddles_controls(struct game *game) {
+    check_paddle_controls(&game->sim.paddle_1, &game->sim.ghost_1,
                           &game->player_1_input);
-    check_paddle_controls(&game->paddle_2, &game->ghost_2,
+    check_paddle_controls(&game->sim.paddle_2, &game->sim.ghost_2,
                           &game->player_2_input);
+}
 
-    while (!game->paused && frame_time > 0.0) {
-        double max_frame_time = 1 / 60.0;
-        double delta_time = fmin(frame_time, max_frame_time);
+// Return when the tick about to be simulated ends, as given by SDL_GetTicks(),
+// the time accumulated reaching up to now from its start.
+static uint32_t get_tick_end_time(struct context *ctx) {
+    return SDL_GetTicks() -
+           (uint32_t)((ctx->accumulator - ctx->tick_duration) * 1000);
+}
 
-        update_paddle(&game->paddle_1, delta_time);
-        update_paddle(&game->paddle_2, delta_time);
-        update_ball(&game->ball, delta_time, game->time);
-        update_ball(&game->ghost_ball, delta_time, game->time);
+// Step the simulation in ticks of a fixed duration so that it behaves the same
+// regardless of the refresh rate of the display.
+static void run_ticks(struct context *ctx, uint64_t *phase_start_time) {
+    struct game *game = &ctx->game;
+    while (ctx->accumulator >= ctx->tick_duration) {
+        ctx->previous_sim = game->sim;
+
+        // Every tick is simulated with the input events that happened by its
+        // end.
+        bool last_tick = ctx->accumulator < 2.0 * ctx->tick_duration;
+        if (ctx->late_latch && last_tick) {
+            latch_controls(ctx);
+        } else {
+            apply_input_events(game, get_tick_end_time(ctx));
+        }
+        check_paddles_controls(game);
+        time_phase(ctx, FRAME_PHASE_CONTROLS, phase_start_time);
+        if (ctx->recording) {
+            begin_recorded_tick(&ctx->recorder, &game->sim);
+        }
+        update_ghosts(&game->sim);
+        time_phase(ctx, FRAME_PHASE_CONTROLS, phase_start_time);
+        update_sim(&game->sim, ctx->tick_duration);
+        if (ctx->recording) {
+            end_recorded_tick(&ctx->recorder, &game->sim);
+        }
+        push_rewind_snapshot(&game->rewind, &game->sim);
+        time_phase(ctx, FRAME_PHASE_SIMULATION, phase_start_time);
 
-        check_ball_hit_wall(game);
-        check_paddle_missed_ball(game);
-        check_paddle_hit_ball(game);
+        ctx->accumulator -= ctx->tick_duration;
+        ctx->timings.ticks++;
+    }
+}
 
-        check_round_over(game);
-        check_round_restart_timeout(game);
+// Return the velocity the local player gives to their paddle in netplay, with
+// the controls of either side of the court.
+static float get_netplay_velocity(struct game *game, struct sim *sim,
+                                  int no) {
+    struct paddle paddle = (no == 1) ? sim->paddle_1 : sim->paddle_2;
+    struct paddle other_paddle = paddle;
+    struct ghost ghost = {0};
+    check_paddle_controls(&paddle, &ghost, &game->player_1_input);
+    check_paddle_controls(&other_paddle, &ghost, &game->player_2_input);
+    return (paddle.velocity != 0) ? paddle.velocity : other_paddle.velocity;
+}
 
-        frame_time -= delta_time;
-        game->time += delta_time;
+// Receive the inputs of the other peer and simulate again the ticks they were
+// mispredicted for, then simulate the ticks due with the local inputs and send
+// them. A peer too far ahead of the other waits for it.
+static void run_netplay_ticks(struct context *ctx,
+                              uint64_t *phase_start_time) {
+    struct game *game = &ctx->game;
+    struct rollback *rollback = &ctx->rollback;
+    double time =
+        SDL_GetPerformanceCounter() / (double)SDL_GetPerformanceFrequency();
+
+    uint8_t packet[NET_MAX_PACKET_LENGTH];
+    size_t length;
+    while ((length = receive_net_packet(ctx->net_link, packet,
+                                        sizeof(packet), time)) > 0) {
+        uint64_t seed;
+        int tick_rate;
+        if (!ctx->netplay_started &&
+            get_rollback_packet_session(packet, length, &seed, &tick_rate)) {
+            init_rollback(rollback, seed, tick_rate, 2);
+            ctx->netplay_started = true;
+            ctx->tick_duration = 1.0 / tick_rate;
+            ctx->accumulator = 0.0;
+        }
+        if (ctx->netplay_started) {
+            read_rollback_packet(rollback, packet, length);
+        }
+    }
+    if (!ctx->netplay_started) {
+        ctx->accumulator = 0.0;
+        apply_input_events(game, SDL_GetTicks());
+        return;
+    }
+    time_phase(ctx, FRAME_PHASE_EVENTS, phase_start_time);
+
+    update_rollback(rollback);
+    while (ctx->accumulator >= ctx->tick_duration) {
+        apply_input_events(game, get_tick_end_time(ctx));
+        float velocity =
+            get_netplay_velocity(game, &rollback->sim, rollback->local_no);
+        if (!step_rollback(rollback, velocity)) {
+            ctx->accumulator = ctx->tick_duration;
+            break;
+        }
+        ctx->accumulator -= ctx->tick_duration;
+        ctx->timings.ticks++;
+    }
+    time_phase(ctx, FRAME_PHASE_SIMULATION, phase_start_time);
+
+    length = write_rollback_packet(rollback, packet);
+    send_net_packet(ctx->net_link, packet, length, time);
+
+    ctx->previous_sim = get_rollback_previous_sim(rollback);
+    // The inputs are applied to the game rather than to the rollback.
+    uint32_t input_time = game->sim.input_time;
+    game->sim = rollback->sim;
+    game->sim.input_time = input_time;
+    // The events are handled from the copy.
+    rollback->sim.events = (struct sim_events){0};
+}
+
+// Step the simulation by the time the frame took, and place everything
+// between its last two ticks, or where the replay shown in its place is.
+static void update_game(struct context *ctx, double frame_time,
+                        uint64_t *phase_start_time,
+                        struct sim_snapshot *frame) {
+    struct game *game = &ctx->game;
+
+    // The ghosts never take over in netplay.
+    if (ctx->net_link == NULL) {
+        check_player_activity(game, game->player_1_input, &game->sim.ghost_1);
+        check_player_activity(game, game->player_2_input, &game->sim.ghost_2);
+    }
+
+    bool idle = game->paused || !ctx->window_visible;
+
+    // The game waits for the end of a replay. Without ticks, the input events
+    // are applied at once.
+    if (idle || game->instant_replay.active) {
+        ctx->accumulator = 0.0;
+        apply_input_events(game, SDL_GetTicks());
+    } else {
+        ctx->accumulator += frame_time;
+    }
+
+    if (ctx->net_link != NULL) {
+        run_netplay_ticks(ctx, phase_start_time);
+    } else {
+        run_ticks(ctx, phase_start_time);
+    }
+    time_phase(ctx, FRAME_PHASE_CONTROLS, phase_start_time);
+
+    // The leftover time is rendered by placing everything between the last
+    // two ticks.
+    float alpha = ctx->accumulator / ctx->tick_duration;
+    struct sim sim = interpolate_sim(&ctx->previous_sim, &game->sim, alpha);
+    if (ctx->late_latch) {
+        // Interpolating would show the players their paddles up to a tick
+        // late.
+        if (!game->sim.ghost_1.active) {
+            sim.paddle_1 = game->sim.paddle_1;
+            sim.input_time = game->sim.input_time;
+        }
+        if (!game->sim.ghost_2.active) {
+            sim.paddle_2 = game->sim.paddle_2;
+            sim.input_time = game->sim.input_time;
+        }
+    }
+    // A replay is shown in place of the game, moving at the pace of the ticks
+    // it replaces.
+    bool replaying = false;
+    if (game->instant_replay.active) {
+        double ticks = idle ? 0.0 : frame_time / ctx->tick_duration;
+        replaying = update_instant_replay(&game->instant_replay, &game->rewind,
+                                          ticks, &sim);
     }
 
     check_game_events(game);
+    time_phase(ctx, FRAME_PHASE_SIMULATION, phase_start_time);
+
+    frame->sim = sim;
+    frame->paused = game->paused;
+    frame->debug_mode = game->debug_mode;
+    frame->replaying = replaying;
+}
+
+// Take the latest snapshot of the simulation thread, and place everything
+// between its last two ticks by how long ago the last one was due.
+static void take_sim_snapshot(struct context *ctx,
+                              struct sim_snapshot *frame) {
+    struct sim_thread *thread = &ctx->sim_thread;
+    SDL_AtomicSet(&thread->window_hidden, !ctx->window_visible);
+    apply_fullscreen_toggles(&ctx->game);
+
+    const struct sim_snapshot *snapshot = get_sim_snapshot(thread);
+    double elapsed = ((int64_t)(ctx->current_time - snapshot->time)) /
+                     (double)SDL_GetPerformanceFrequency();
+    float alpha = fmax(fmin(elapsed / ctx->tick_duration, 1.0), 0.0);
+    frame->sim =
+        interpolate_sim(&snapshot->previous_sim, &snapshot->sim, alpha);
+    frame->paused = snapshot->paused;
+    frame->debug_mode = snapshot->debug_mode;
+    frame->replaying = snapshot->replaying;
+
+    ctx->timings.ticks += snapshot->ticks - ctx->sim_thread_ticks;
+    ctx->sim_thread_ticks = snapshot->ticks;
+}
+
+void main_loop(void *arg) {
+    struct context *ctx = arg;
+
+    struct game *game = &ctx->game;
+
+    // Any event wakes the game up from sleeping, and may change what is on the
+    // screen.
+    SDL_Event event = {0};
+    int timeout = get_idle_timeout(ctx);
+    if (timeout == 0 && ctx->pacer.enabled) {
+        // Start the frame as late as it can be drawn before the next refresh,
+        // and only then poll the events received meanwhile.
+        wait_for_frame(&ctx->pacer);
+    }
+    uint64_t phase_start_time = SDL_GetPerformanceCounter();
+    int has_event = timeout > 0 ? SDL_WaitEventTimeout(&event, timeout)
+                                : SDL_PollEvent(&event);
+    if (timeout > 0) {
+        // Sleeping isn't polling.
+        phase_start_time = SDL_GetPerformanceCounter();
+    }
+    for (; has_event == 1; has_event = SDL_PollEvent(&event)) {
+        check_event(ctx, event);
+    }
+
+    uint64_t previous_time = ctx->current_time;
+    ctx->current_time = SDL_GetPerformanceCounter();
+    double measured_frame_time = (ctx->current_time - previous_time) /
+                                 (double)SDL_GetPerformanceFrequency();
+    double frame_time = fmin(measured_frame_time, MAX_FRAME_TIME);
+
+    time_phase(ctx, FRAME_PHASE_EVENTS, &phase_start_time);
+
+    struct sim_snapshot frame;
+    if (ctx->sim_thread.thread != NULL) {
+        take_sim_snapshot(ctx, &frame);
+        time_phase(ctx, FRAME_PHASE_SIMULATION, &phase_start_time);
+    } else {
+        update_game(ctx, frame_time, &phase_start_time, &frame);
+    }
+    struct sim sim = frame.sim;
 
-    SDL_SetRenderDrawColor(ctx->renderer.renderer, 0, 0, 0, 255);
-    SDL_RenderClear(ctx->renderer.renderer);
+    add_phase_time(&ctx->timings, FRAME_PHASE_AUDIO,
+                   SDL_AtomicGet(&game->tonegen.callback_time) / 1e6);
 
-    SDL_SetRenderDrawColor(ctx->renderer.renderer, 255, 255, 255, 255);
+    // Nothing moves while the game is idle, so a frame only needs to be drawn
+    // when an event may have changed it.
+    bool idle = frame.paused || !ctx->window_visible;
+    if (idle && !ctx->redraw_requested) {
+        end_frame_timings(&ctx->timings, measured_frame_time);
+        return;
+    }
+    ctx->redraw_requested = false;
+
+    struct draw_list *list = &ctx->draw_list;
+
+    // The net and the scores only change when a point is scored, so they are
+    // drawn on a background that is kept until then.
+    if (sim.paddle_1.score != ctx->background_score_1 ||
+        sim.paddle_2.score != ctx->background_score_2) {
+        clear_draw_list(list, (struct color){0, 0, 0, 255});
+        set_draw_color(list, (struct color){255, 255, 255, 255});
+        render_score(list, sim.paddle_1);
+        render_score(list, sim.paddle_2);
+        render_net(list);
+        renderer_wrapper_set_background(&ctx->renderer, list);
+
+        ctx->background_score_1 = sim.paddle_1.score;
+        ctx->background_score_2 = sim.paddle_2.score;
+    }
 
-    render_score(ctx->renderer, game->paddle_1);
-    render_score(ctx->renderer, game->paddle_2);
+    clear_draw_list(list, (struct color){0, 0, 0, 255});
+    set_draw_color(list, (struct color){255, 255, 255, 255});
 
-    render_net(ctx->renderer);
-    render_paddle(ctx->renderer, game, game->paddle_1);
-    render_paddle(ctx->renderer, game, game->paddle_2);
-    render_ball(ctx->renderer, game->ball);
-    if (game->debug_mode) {
-        debug_render_ghost_ball(ctx->renderer, game->ghost_ball);
+    render_paddle(list, &sim, sim.paddle_1);
+    render_paddle(list, &sim, sim.paddle_2);
+    render_ball(list, sim.ball);
+    if (frame.replaying) {
+        render_replay_marker(list, sim.time);
+    }
+    if (frame.debug_mode) {
+        debug_render_prediction(list, sim.ball, sim.prediction);
+        render_frame_timings(list, &ctx->timings, (struct vec2){20, 20});
     }
 
-    tonegen_generate(&game->tonegen, ctx->audio_device_id);
-    tonegen_queue(&game->tonegen, ctx->audio_device_id);
+    renderer_wrapper_draw(&ctx->renderer, list);
+    time_phase(ctx, FRAME_PHASE_RENDERING, &phase_start_time);
 
+    note_frame_submitted(&ctx->pacer);
     SDL_RenderPresent(ctx->renderer.renderer);
+    time_phase(ctx, FRAME_PHASE_PRESENT, &phase_start_time);
+    // Nothing moves while the game is idle, so the frame is as up to date with
+    // the inputs as it can be.
+    note_present(&ctx->input_latency, idle ? SDL_GetTicks() : sim.input_time);
+    note_frame_presented(&ctx->pacer);
+    update_startup(&ctx->startup);
+
+    end_frame_timings(&ctx->timings, measured_frame_time);
 }
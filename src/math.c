@@ -4,14 +4,58 @@ float clamp(float x, float min, float max) {
     return fmaxf(min, fminf(x, max));
 }
 
+float lerp(float a, float b, float t) {
+    return a + ((b - a) * t);
+}
+
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+// Return a generator with its state expanded from the given seed with
+// SplitMix64, as recommended by the authors of xoshiro, so that similar seeds
+// still produce unrelated sequences.
+struct rng make_rng(uint64_t seed) {
+    struct rng rng = {0};
+    for (int i = 0; i < 4; i += 2) {
+        uint64_t x = splitmix64(&seed);
+        rng.state[i] = (uint32_t)x;
+        rng.state[i + 1] = (uint32_t)(x >> 32);
+    }
+    return rng;
+}
+
+static uint32_t rotl(uint32_t x, int k) {
+    return (x << k) | (x >> (32 - k));
+}
+
+uint32_t rng_next(struct rng *rng) {
+    uint32_t *s = rng->state;
+    uint32_t result = rotl(s[1] * 5, 7) * 9;
+    uint32_t t = s[1] << 9;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 11);
+    return result;
+}
+
 // Return a random integer between min and max (inclusive).
-int rand_range(int min, int max) {
-    return min + (rand() / ((RAND_MAX / (max - min + 1)) + 1));
+int rand_range(struct rng *rng, int min, int max) {
+    uint32_t range = (uint32_t)(max - min) + 1;
+    return min + (int)(((uint64_t)rng_next(rng) * range) >> 32);
 }
 
 // Return a random floating-point number between min and max (inclusive).
-float frand_range(float min, float max) {
-    return min + (rand() / ((double)RAND_MAX / (max - min)));
+float frand_range(struct rng *rng, float min, float max) {
+    // The top 24 bits are as many as a float can represent exactly.
+    float x = (rng_next(rng) >> 8) / (float)((1 << 24) - 1);
+    return min + (x * (max - min));
 }
 
 int sign(int x) {
@@ -1,13 +1,23 @@
 #pragma once
 
-#include <SDL.h>
 #include <math.h>
+#include <stdint.h>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
+// The state of a xoshiro128** pseudorandom number generator. Every game owns
+// one so that games can be reproduced from their seed and simulated in
+// parallel.
+struct rng {
+    uint32_t state[4];
+};
+
 float clamp(float x, float min, float max);
-int rand_range(int min, int max);
-float frand_range(float min, float max);
+float lerp(float a, float b, float t);
+struct rng make_rng(uint64_t seed);
+uint32_t rng_next(struct rng *rng);
+int rand_range(struct rng *rng, int min, int max);
+float frand_range(struct rng *rng, float min, float max);
 int sign(int x);
@@ -0,0 +1,184 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "net.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "math.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET socket_t;
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int socket_t;
+#define INVALID_SOCKET -1
+#define closesocket close
+#endif
+
+#define MAX_DELAYED_PACKETS 64
+
+struct delayed_packet {
+    double send_time; // in seconds
+    size_t length;
+    unsigned char data[NET_MAX_PACKET_LENGTH];
+};
+
+struct net_link {
+    socket_t socket;
+    struct sockaddr_in peer_address;
+    double delay; // in seconds
+    float loss;   // the probability of a packet being dropped
+    struct rng rng;
+    // The packets waiting for their delay, oldest first.
+    struct delayed_packet delayed[MAX_DELAYED_PACKETS];
+    int delayed_start;
+    int delayed_length;
+};
+
+static bool resolve_peer(const char *peer, struct sockaddr_in *address) {
+    const char *colon = strrchr(peer, ':');
+    if (colon == NULL || colon - peer >= 256) {
+        return false;
+    }
+    char host[256];
+    memcpy(host, peer, colon - peer);
+    host[colon - peer] = '\0';
+
+    struct addrinfo hints = {
+        .ai_family = AF_INET,
+        .ai_socktype = SOCK_DGRAM,
+    };
+    struct addrinfo *info;
+    if (getaddrinfo(host, colon + 1, &hints, &info) != 0) {
+        return false;
+    }
+    memcpy(address, info->ai_addr, sizeof(struct sockaddr_in));
+    freeaddrinfo(info);
+    return true;
+}
+
+struct net_link *open_net_link(int port, const char *peer, double delay,
+                               float loss) {
+#ifdef _WIN32
+    WSADATA wsa_data;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+        return NULL;
+    }
+#endif
+    struct net_link *link = calloc(1, sizeof(struct net_link));
+    if (link == NULL) {
+        return NULL;
+    }
+    link->delay = delay;
+    link->loss = loss;
+    link->rng = make_rng(port);
+    link->socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (link->socket == INVALID_SOCKET) {
+        free(link);
+        return NULL;
+    }
+
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    bool ok = bind(link->socket, (struct sockaddr *)&address,
+                   sizeof(address)) == 0 &&
+              resolve_peer(peer, &link->peer_address);
+    // The game polls for packets every frame.
+#ifdef _WIN32
+    u_long non_blocking = 1;
+    ok = ok && ioctlsocket(link->socket, FIONBIO, &non_blocking) == 0;
+#else
+    ok = ok && fcntl(link->socket, F_SETFL, O_NONBLOCK) == 0;
+#endif
+    if (!ok) {
+        close_net_link(link);
+        return NULL;
+    }
+    return link;
+}
+
+void close_net_link(struct net_link *link) {
+    closesocket(link->socket);
+    free(link);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+static void send_now(struct net_link *link, const void *data, size_t length) {
+    // A packet that can't be sent is as good as lost.
+    sendto(link->socket, data, length, 0,
+           (struct sockaddr *)&link->peer_address,
+           sizeof(link->peer_address));
+}
+
+static void send_oldest_delayed_packet(struct net_link *link) {
+    struct delayed_packet *packet = &link->delayed[link->delayed_start];
+    send_now(link, packet->data, packet->length);
+    link->delayed_start = (link->delayed_start + 1) % MAX_DELAYED_PACKETS;
+    link->delayed_length--;
+}
+
+static void send_delayed_packets(struct net_link *link, double time) {
+    while (link->delayed_length > 0 &&
+           link->delayed[link->delayed_start].send_time <= time) {
+        send_oldest_delayed_packet(link);
+    }
+}
+
+void send_net_packet(struct net_link *link, const void *data, size_t length,
+                     double time) {
+    send_delayed_packets(link, time);
+    if (length > NET_MAX_PACKET_LENGTH ||
+        (link->loss > 0.0f &&
+         frand_range(&link->rng, 0.0f, 1.0f) < link->loss)) {
+        return;
+    }
+    if (link->delay <= 0.0) {
+        send_now(link, data, length);
+        return;
+    }
+    if (link->delayed_length == MAX_DELAYED_PACKETS) {
+        // The oldest packet is sent early rather than lost.
+        send_oldest_delayed_packet(link);
+    }
+    int index =
+        (link->delayed_start + link->delayed_length) % MAX_DELAYED_PACKETS;
+    struct delayed_packet *packet = &link->delayed[index];
+    packet->send_time = time + link->delay;
+    packet->length = length;
+    memcpy(packet->data, data, length);
+    link->delayed_length++;
+}
+
+size_t receive_net_packet(struct net_link *link, void *data, size_t length,
+                          double time) {
+    send_delayed_packets(link, time);
+    for (;;) {
+        struct sockaddr_in address;
+        socklen_t address_length = sizeof(address);
+        long received = recvfrom(link->socket, data, length, 0,
+                                 (struct sockaddr *)&address, &address_length);
+        if (received <= 0) {
+            return 0;
+        }
+        // Anyone may send packets to the socket.
+        if (address.sin_addr.s_addr == link->peer_address.sin_addr.s_addr &&
+            address.sin_port == link->peer_address.sin_port) {
+            return received;
+        }
+    }
+}
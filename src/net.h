@@ -0,0 +1,21 @@
+#pragma once
+#include <stddef.h>
+
+// A UDP socket exchanging packets with a single peer. To test netplay over
+// loopback, the packets it sends may be delayed and randomly dropped.
+
+#define NET_MAX_PACKET_LENGTH 512
+
+struct net_link;
+
+// The peer is given as HOST:PORT. Return NULL when the socket couldn't be
+// opened or the peer couldn't be resolved.
+struct net_link *open_net_link(int port, const char *peer, double delay,
+                               float loss);
+void close_net_link(struct net_link *link);
+// The times are in seconds, from any clock as long as it's always the same.
+void send_net_packet(struct net_link *link, const void *data, size_t length,
+                     double time);
+// Return the length of the packet received, or 0 if there is none.
+size_t receive_net_packet(struct net_link *link, void *data, size_t length,
+                          double time);
@@ -0,0 +1,122 @@
+#include "pacer.h"
+
+#include "math.h"
+
+// The weight of the last frame in the smoothed costs.
+static const double COST_SMOOTHING = 1.0 / 16.0;
+
+// The margin covers the mean cost of the frames plus this many deviations
+// from it, plus a little slack for the present itself.
+static const double MARGIN_DEVIATIONS = 4.0;
+static const double MARGIN_SLACK = 0.0005; // in seconds
+
+// The longest the sleeps spin for, however late SDL_Delay() has woken up
+// once, so that a rare late wake up doesn't keep a core busy for long.
+static const double MAX_SPIN = 0.002; // in seconds
+
+struct frame_pacer make_frame_pacer(int refresh_rate, bool vsync) {
+    struct frame_pacer pacer = {
+        .enabled = true,
+        .vsync = vsync,
+        .delay_overshoot = 0.001,
+    };
+    if (refresh_rate > 0) {
+        pacer.period = 1.0 / refresh_rate;
+        // Start early, and get later as the frames prove to be cheap.
+        pacer.cost_mean = pacer.period / 2.0;
+        pacer.margin = pacer.period / 2.0;
+    }
+    return pacer;
+}
+
+// Sleep until a time with SDL_Delay() for as long as it can't oversleep, and
+// only spin for the rest so as not to keep a core busy.
+static void sleep_until(struct frame_pacer *pacer, uint64_t time) {
+    double frequency = SDL_GetPerformanceFrequency();
+    uint64_t now = SDL_GetPerformanceCounter();
+    while (now < time) {
+        double remaining = (time - now) / frequency;
+        if (remaining - pacer->delay_overshoot < 0.001) {
+            break;
+        }
+        uint32_t delay = (remaining - pacer->delay_overshoot) * 1000;
+        SDL_Delay(delay);
+        uint64_t woken = SDL_GetPerformanceCounter();
+        // Remember the worst overshoot, forgetting it over the next sleeps.
+        double overshoot = (woken - now) / frequency - delay / 1000.0;
+        pacer->delay_overshoot =
+            fmin(fmax(overshoot, pacer->delay_overshoot * 0.95), MAX_SPIN);
+        now = woken;
+    }
+    while (SDL_GetPerformanceCounter() < time) {
+    }
+}
+
+// Wait until the margin before the next refresh. A frame that is already late
+// starts at once.
+void wait_for_frame(struct frame_pacer *pacer) {
+    uint64_t now = SDL_GetPerformanceCounter();
+    uint64_t margin = pacer->margin * SDL_GetPerformanceFrequency();
+    pacer->on_time = pacer->period > 0 && pacer->deadline > now;
+    if (pacer->on_time && pacer->deadline - now > margin) {
+        sleep_until(pacer, pacer->deadline - margin);
+        now = SDL_GetPerformanceCounter();
+    }
+    pacer->wake_time = now;
+}
+
+void note_frame_submitted(struct frame_pacer *pacer) {
+    pacer->submit_time = SDL_GetPerformanceCounter();
+}
+
+// Adapt the margin to the cost of the frame, and predict the next refresh.
+// With vsync, the present returns on the refresh, which is where the next
+// one is counted from.
+void note_frame_presented(struct frame_pacer *pacer) {
+    if (pacer->period == 0) {
+        return;
+    }
+    uint64_t now = SDL_GetPerformanceCounter();
+    double frequency = SDL_GetPerformanceFrequency();
+    uint64_t period = pacer->period * frequency;
+
+    pacer->frames++;
+    bool missed = false;
+    if (pacer->on_time) {
+        missed = pacer->vsync ? now > pacer->deadline + period / 2
+                              : pacer->submit_time > pacer->deadline;
+    }
+
+    double cost = (pacer->submit_time - pacer->wake_time) / frequency;
+    pacer->cost_mean += (cost - pacer->cost_mean) * COST_SMOOTHING;
+    double deviation = fabs(cost - pacer->cost_mean);
+    pacer->cost_deviation +=
+        (deviation - pacer->cost_deviation) * COST_SMOOTHING;
+    if (missed) {
+        // Back off quickly, and only get closer to the refresh slowly.
+        pacer->missed_frames++;
+        pacer->cost_deviation = fmax(pacer->cost_deviation * 2.0, deviation);
+    }
+    pacer->margin = fmin(pacer->cost_mean +
+                             MARGIN_DEVIATIONS * pacer->cost_deviation +
+                             MARGIN_SLACK,
+                         pacer->period);
+
+    if (pacer->vsync) {
+        pacer->deadline = now + period;
+    } else if (pacer->on_time) {
+        pacer->deadline += period;
+    } else {
+        pacer->deadline = now + period;
+    }
+}
+
+void report_frame_pacer(const struct frame_pacer *pacer) {
+    if (!pacer->enabled || pacer->period == 0 || pacer->frames == 0) {
+        return;
+    }
+    SDL_Log("Frame pacing over %ld frames at %.0f Hz: %ld missed, %.2f ms "
+            "mean cost, %.2f ms margin",
+            pacer->frames, 1.0 / pacer->period, pacer->missed_frames,
+            pacer->cost_mean * 1000, pacer->margin * 1000);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Just in time frames: instead of drawing a frame right after the last one
+// was presented and waiting for the refresh with it, the game sleeps until
+// the time it predicts it needs to draw the frame before the next refresh,
+// then handles the inputs, simulates and draws as late as it can.
+struct frame_pacer {
+    bool enabled;
+    bool vsync;    // whether the presents wait for the refreshes
+    double period; // between refreshes in seconds, or 0 when uncapped
+    uint64_t deadline; // of the next refresh, in performance counter ticks
+    uint64_t wake_time;   // when the frame started
+    uint64_t submit_time; // when it was done drawing
+    bool on_time;         // whether the frame started before its deadline
+
+    // How long the frames take to draw, smoothed over the last ones, and the
+    // margin before the refresh the frames start at.
+    double cost_mean;      // in seconds
+    double cost_deviation; // in seconds
+    double margin;         // in seconds
+    // How late SDL_Delay() wakes up, to only spin for that long.
+    double delay_overshoot; // in seconds
+
+    long frames;
+    long missed_frames; // presented after the refresh they aimed at
+};
+
+// The refresh rate is 0 to draw the frames as fast as they can be.
+struct frame_pacer make_frame_pacer(int refresh_rate, bool vsync);
+void wait_for_frame(struct frame_pacer *pacer);
+void note_frame_submitted(struct frame_pacer *pacer);
+void note_frame_presented(struct frame_pacer *pacer);
+void report_frame_pacer(const struct frame_pacer *pacer);
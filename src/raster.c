@@ -0,0 +1,161 @@
+#include "raster.h"
+
+#include <math.h>
+#include <string.h>
+
+#if !defined(RASTER_NO_SIMD) &&                                               \
+    (defined(__SSE2__) || defined(_M_X64) ||                                   \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define RASTER_SSE
+#include <emmintrin.h>
+#elif !defined(RASTER_NO_SIMD) && defined(__ARM_NEON)
+#define RASTER_NEON
+#include <arm_neon.h>
+#endif
+
+// The bytes stored at once, which hold a whole number of pixels of any format.
+#define PATTERN_SIZE 16
+
+int get_pixel_size(enum pixel_format format) {
+    return (format == PIXEL_FORMAT_GRAY8) ? 1 : 4;
+}
+
+// Repeat the pixel of a color over a pattern.
+static void make_pattern(uint8_t *pattern, struct color color,
+                         enum pixel_format format) {
+    if (format == PIXEL_FORMAT_GRAY8) {
+        uint8_t luma = (77 * color.r + 150 * color.g + 29 * color.b + 128) >> 8;
+        memset(pattern, luma, PATTERN_SIZE);
+        return;
+    }
+    for (int i = 0; i < PATTERN_SIZE; i += 4) {
+        pattern[i] = color.r;
+        pattern[i + 1] = color.g;
+        pattern[i + 2] = color.b;
+        pattern[i + 3] = color.a;
+    }
+}
+
+// Fill a span starting on a pixel with a pattern. Every store starts a whole
+// number of patterns from the start of the span, so the pixels line up.
+static void fill_span(uint8_t *span, int length, const uint8_t *pattern) {
+    int i = 0;
+#if defined(RASTER_SSE)
+    __m128i v = _mm_loadu_si128((const __m128i *)pattern);
+    for (; i + 4 * PATTERN_SIZE <= length; i += 4 * PATTERN_SIZE) {
+        _mm_storeu_si128((__m128i *)(span + i), v);
+        _mm_storeu_si128((__m128i *)(span + i + PATTERN_SIZE), v);
+        _mm_storeu_si128((__m128i *)(span + i + 2 * PATTERN_SIZE), v);
+        _mm_storeu_si128((__m128i *)(span + i + 3 * PATTERN_SIZE), v);
+    }
+    for (; i + PATTERN_SIZE <= length; i += PATTERN_SIZE) {
+        _mm_storeu_si128((__m128i *)(span + i), v);
+    }
+#elif defined(RASTER_NEON)
+    uint8x16_t v = vld1q_u8(pattern);
+    for (; i + PATTERN_SIZE <= length; i += PATTERN_SIZE) {
+        vst1q_u8(span + i, v);
+    }
+#else
+    for (; i + PATTERN_SIZE <= length; i += PATTERN_SIZE) {
+        memcpy(span + i, pattern, PATTERN_SIZE);
+    }
+#endif
+    memcpy(span + i, pattern, length - i);
+}
+
+static void fill_rows(struct framebuffer *framebuffer, int x0, int y0, int x1,
+                      int y1, const uint8_t *pattern) {
+    int pixel_size = get_pixel_size(framebuffer->format);
+    int row_length = framebuffer->width * pixel_size;
+    uint8_t *row = framebuffer->pixels + (size_t)y0 * framebuffer->pitch;
+    if (x0 == 0 && x1 == framebuffer->width &&
+        framebuffer->pitch == row_length) {
+        // The rows follow each other, so they make a single span.
+        fill_span(row, (y1 - y0) * row_length, pattern);
+        return;
+    }
+    for (int y = y0; y < y1; y++, row += framebuffer->pitch) {
+        fill_span(row + x0 * pixel_size, (x1 - x0) * pixel_size, pattern);
+    }
+}
+
+// Round a logical coordinate to the edge of a pixel, clamped to a range.
+static int to_edge(float coordinate, float scale, float offset, int min,
+                   int max) {
+    int edge = floorf(offset + coordinate * scale + 0.5f);
+    return (edge < min) ? min : (edge > max) ? max : edge;
+}
+
+// Draw a frame scaled to fit the framebuffer and centered like the game does
+// in its window, the rest being filled with the clear color. Rectangles are
+// covered by the pixels whose centers are inside them, and never vanish when
+// they are thinner than a pixel. Like with the hardware renderers, the ones of
+// negative size span back from their position, as some segments of the
+// digits do.
+void rasterize_draw_list(struct framebuffer *framebuffer,
+                         const struct draw_list *list) {
+    uint8_t patterns[DRAW_LIST_MAX_COLORS][PATTERN_SIZE];
+    for (int i = 0; i < list->colors_length; i++) {
+        make_pattern(patterns[i], list->colors[i], framebuffer->format);
+    }
+    uint8_t clear_pattern[PATTERN_SIZE];
+    make_pattern(clear_pattern, list->clear_color, framebuffer->format);
+    fill_rows(framebuffer, 0, 0, framebuffer->width, framebuffer->height,
+              clear_pattern);
+
+    float scale = fminf(framebuffer->width / (float)LOGICAL_WIDTH,
+                        framebuffer->height / (float)LOGICAL_HEIGHT);
+    float viewport_x = (framebuffer->width - scale * LOGICAL_WIDTH) / 2.0f;
+    float viewport_y = (framebuffer->height - scale * LOGICAL_HEIGHT) / 2.0f;
+    int min_x = to_edge(0.0f, scale, viewport_x, 0, framebuffer->width);
+    int max_x =
+        to_edge(LOGICAL_WIDTH, scale, viewport_x, 0, framebuffer->width);
+    int min_y = to_edge(0.0f, scale, viewport_y, 0, framebuffer->height);
+    int max_y =
+        to_edge(LOGICAL_HEIGHT, scale, viewport_y, 0, framebuffer->height);
+
+    for (int i = 0; i < list->rects_length; i++) {
+        struct rect rect = list->rects[i];
+        if (rect.w < 0.0f) {
+            rect.x += rect.w;
+            rect.w = -rect.w;
+        }
+        if (rect.h < 0.0f) {
+            rect.y += rect.h;
+            rect.h = -rect.h;
+        }
+        if (rect.w == 0.0f || rect.h == 0.0f) {
+            continue;
+        }
+        int x0 = to_edge(rect.x, scale, viewport_x, min_x, max_x);
+        int x1 = to_edge(rect.x + rect.w, scale, viewport_x, min_x, max_x);
+        int y0 = to_edge(rect.y, scale, viewport_y, min_y, max_y);
+        int y1 = to_edge(rect.y + rect.h, scale, viewport_y, min_y, max_y);
+        if (x1 == x0 && x1 < max_x && rect.x + rect.w > 0.0f) {
+            x1++;
+        }
+        if (y1 == y0 && y1 < max_y && rect.y + rect.h > 0.0f) {
+            y1++;
+        }
+        if (x0 < x1 && y0 < y1) {
+            fill_rows(framebuffer, x0, y0, x1, y1,
+                      patterns[list->rect_colors[i]]);
+        }
+    }
+}
+
+// Hash the pixels, leaving out the padding of the rows, to compare frames
+// between builds and platforms.
+uint64_t hash_framebuffer(const struct framebuffer *framebuffer) {
+    uint64_t hash = 0xcbf29ce484222325;
+    int row_length = framebuffer->width * get_pixel_size(framebuffer->format);
+    for (int y = 0; y < framebuffer->height; y++) {
+        const uint8_t *row =
+            framebuffer->pixels + (size_t)y * framebuffer->pitch;
+        for (int x = 0; x < row_length; x++) {
+            hash = (hash ^ row[x]) * 0x100000001b3; // FNV-1a
+        }
+    }
+    return hash;
+}
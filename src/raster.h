@@ -0,0 +1,33 @@
+#pragma once
+#include <stdint.h>
+
+#include "draw.h"
+
+// A software rasterizer drawing draw lists into a framebuffer in memory, to
+// produce frames without a display or a GPU. The rectangles are filled a span
+// at a time with SIMD stores. Nothing in here may depend on SDL.
+
+// Define RASTER_NO_SIMD to fill the spans with plain stores, which must give
+// exactly the same pixels.
+
+#define FRAMEBUFFER_MIN_SIZE 16
+#define FRAMEBUFFER_MAX_SIZE 4096
+
+enum pixel_format {
+    PIXEL_FORMAT_GRAY8,    // the luma of the colors
+    PIXEL_FORMAT_RGBA8888, // the bytes of each pixel in that order
+};
+
+// The pixels are owned by the caller, and rows may be padded.
+struct framebuffer {
+    uint8_t *pixels;
+    int width;
+    int height;
+    int pitch; // in bytes, between the start of two rows
+    enum pixel_format format;
+};
+
+int get_pixel_size(enum pixel_format format);
+void rasterize_draw_list(struct framebuffer *framebuffer,
+                         const struct draw_list *list);
+uint64_t hash_framebuffer(const struct framebuffer *framebuffer);
@@ -0,0 +1,614 @@
+#include "record.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char HEADER_MAGIC[8] = "TNSREC\r\n";
+static const char TRAILER_MAGIC[8] = "TNSIDX\r\n";
+
+enum {
+    HEADER_LENGTH = 32,  // without the state
+    TRAILER_LENGTH = 32,
+    KEYFRAME_LENGTH = 16 + RECORDING_STATE_LENGTH,
+};
+
+// The flags of an entry of the stream.
+enum {
+    GHOST_1_ACTIVE = 1 << 0,
+    GHOST_2_ACTIVE = 1 << 1,
+    PADDLE_1_VELOCITY = 1 << 2, // followed by a float
+    PADDLE_2_VELOCITY = 1 << 3, // followed by a float
+    STATE = 1 << 4,             // followed by a state
+};
+
+struct tick_input get_tick_input(const struct sim *sim) {
+    struct tick_input input = {
+        .ghost_1_active = sim->ghost_1.active,
+        .ghost_2_active = sim->ghost_2.active,
+    };
+    if (!input.ghost_1_active) {
+        input.paddle_1_velocity = sim->paddle_1.velocity;
+    }
+    if (!input.ghost_2_active) {
+        input.paddle_2_velocity = sim->paddle_2.velocity;
+    }
+    return input;
+}
+
+// Set the controls of the paddles the way the game does before a tick.
+void apply_tick_input(struct sim *sim, struct tick_input input) {
+    sim->ghost_1.active = input.ghost_1_active;
+    sim->ghost_2.active = input.ghost_2_active;
+    sim->paddle_1.velocity = input.ghost_1_active ? sim->ghost_1.velocity
+                                                  : input.paddle_1_velocity;
+    sim->paddle_2.velocity = input.ghost_2_active ? sim->ghost_2.velocity
+                                                  : input.paddle_2_velocity;
+}
+
+static void put_u32(uint8_t *bytes, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        bytes[i] = value >> (8 * i);
+    }
+}
+
+static void put_u64(uint8_t *bytes, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = value >> (8 * i);
+    }
+}
+
+static uint32_t get_u32(const uint8_t *bytes) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= (uint32_t)bytes[i] << (8 * i);
+    }
+    return value;
+}
+
+static uint64_t get_u64(const uint8_t *bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) {
+        value |= (uint64_t)bytes[i] << (8 * i);
+    }
+    return value;
+}
+
+static void put_f32(uint8_t *bytes, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    put_u32(bytes, bits);
+}
+
+static void put_f64(uint8_t *bytes, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, 8);
+    put_u64(bytes, bits);
+}
+
+static float get_f32(const uint8_t *bytes) {
+    uint32_t bits = get_u32(bytes);
+    float value;
+    memcpy(&value, &bits, 4);
+    return value;
+}
+
+static double get_f64(const uint8_t *bytes) {
+    uint64_t bits = get_u64(bytes);
+    double value;
+    memcpy(&value, &bits, 8);
+    return value;
+}
+
+// The states are written field by field rather than as they are in memory, so
+// that the padding of struct sim, whose bytes are unspecified, never ends up
+// in a recording or in a comparison of states. Each function returns where the
+// next field goes.
+
+static uint8_t *put_rect(uint8_t *bytes, struct rect rect) {
+    put_f32(bytes, rect.x);
+    put_f32(bytes + 4, rect.y);
+    put_f32(bytes + 8, rect.w);
+    put_f32(bytes + 12, rect.h);
+    return bytes + 16;
+}
+
+static uint8_t *put_paddle(uint8_t *bytes, const struct paddle *paddle) {
+    put_u32(bytes, paddle->no);
+    bytes = put_rect(bytes + 4, paddle->rect);
+    put_f32(bytes, paddle->velocity);
+    put_f32(bytes + 4, paddle->max_speed);
+    put_u32(bytes + 8, paddle->score);
+    return bytes + 12;
+}
+
+static uint8_t *put_ghost(uint8_t *bytes, const struct ghost *ghost) {
+    put_u32(bytes, ghost->idle_offset);
+    put_f32(bytes + 4, ghost->speed);
+    put_f32(bytes + 8, ghost->bias);
+    bytes[12] = ghost->active;
+    put_f32(bytes + 13, ghost->velocity);
+    put_f32(bytes + 17, ghost->max_bias);
+    put_u32(bytes + 21, ghost->max_idle_offset);
+    return bytes + 25;
+}
+
+static void put_state(uint8_t *bytes, const struct sim *sim) {
+    for (int i = 0; i < 4; i++) {
+        put_u32(bytes + 4 * i, sim->rng.state[i]);
+    }
+    bytes = put_paddle(bytes + 16, &sim->paddle_1);
+    bytes = put_paddle(bytes, &sim->paddle_2);
+    put_f32(bytes, sim->ghosts_sharpness);
+    bytes = put_ghost(bytes + 4, &sim->ghost_1);
+    bytes = put_ghost(bytes, &sim->ghost_2);
+
+    bytes = put_rect(bytes, sim->ball.rect);
+    put_f32(bytes, sim->ball.velocity.x);
+    put_f32(bytes + 4, sim->ball.velocity.y);
+    bytes[8] = sim->ball.served;
+    put_u32(bytes + 9, sim->ball.serve_time);
+    bytes[13] = sim->ball.horizontal_bounce;
+    bytes += 14;
+
+    put_u32(bytes, sim->prediction.paddle_no);
+    put_f32(bytes + 4, sim->prediction.x);
+    put_f32(bytes + 8, sim->prediction.y);
+    put_f64(bytes + 12, sim->prediction.time);
+    bytes += 20;
+
+    put_u32(bytes, sim->max_score);
+    put_f64(bytes + 4, sim->time);
+    bytes[12] = sim->round_over;
+    put_u32(bytes + 13, sim->round_restart_time);
+    bytes[17] = sim->events.paddle_missed_ball;
+    bytes[18] = sim->events.ball_hit_paddle;
+    bytes[19] = sim->events.ball_hit_wall;
+    bytes[20] = sim->events.round_over;
+}
+
+static const uint8_t *get_rect(const uint8_t *bytes, struct rect *rect) {
+    rect->x = get_f32(bytes);
+    rect->y = get_f32(bytes + 4);
+    rect->w = get_f32(bytes + 8);
+    rect->h = get_f32(bytes + 12);
+    return bytes + 16;
+}
+
+static const uint8_t *get_paddle(const uint8_t *bytes,
+                                 struct paddle *paddle) {
+    paddle->no = (int32_t)get_u32(bytes);
+    bytes = get_rect(bytes + 4, &paddle->rect);
+    paddle->velocity = get_f32(bytes);
+    paddle->max_speed = get_f32(bytes + 4);
+    paddle->score = (int32_t)get_u32(bytes + 8);
+    return bytes + 12;
+}
+
+static const uint8_t *get_ghost(const uint8_t *bytes, struct ghost *ghost) {
+    ghost->idle_offset = (int32_t)get_u32(bytes);
+    ghost->speed = get_f32(bytes + 4);
+    ghost->bias = get_f32(bytes + 8);
+    ghost->active = bytes[12];
+    ghost->velocity = get_f32(bytes + 13);
+    ghost->max_bias = get_f32(bytes + 17);
+    ghost->max_idle_offset = (int32_t)get_u32(bytes + 21);
+    return bytes + 25;
+}
+
+static struct sim get_state(const uint8_t *bytes) {
+    struct sim sim = {0};
+    for (int i = 0; i < 4; i++) {
+        sim.rng.state[i] = get_u32(bytes + 4 * i);
+    }
+    bytes = get_paddle(bytes + 16, &sim.paddle_1);
+    bytes = get_paddle(bytes, &sim.paddle_2);
+    sim.ghosts_sharpness = get_f32(bytes);
+    bytes = get_ghost(bytes + 4, &sim.ghost_1);
+    bytes = get_ghost(bytes, &sim.ghost_2);
+
+    bytes = get_rect(bytes, &sim.ball.rect);
+    sim.ball.velocity.x = get_f32(bytes);
+    sim.ball.velocity.y = get_f32(bytes + 4);
+    sim.ball.served = bytes[8];
+    sim.ball.serve_time = get_u32(bytes + 9);
+    sim.ball.horizontal_bounce = bytes[13];
+    bytes += 14;
+
+    sim.prediction.paddle_no = (int32_t)get_u32(bytes);
+    sim.prediction.x = get_f32(bytes + 4);
+    sim.prediction.y = get_f32(bytes + 8);
+    sim.prediction.time = get_f64(bytes + 12);
+    bytes += 20;
+
+    sim.max_score = (int32_t)get_u32(bytes);
+    sim.time = get_f64(bytes + 4);
+    sim.round_over = bytes[12];
+    sim.round_restart_time = get_u32(bytes + 13);
+    sim.events.paddle_missed_ball = bytes[17];
+    sim.events.ball_hit_paddle = bytes[18];
+    sim.events.ball_hit_wall = bytes[19];
+    sim.events.round_over = bytes[20];
+    return sim;
+}
+
+// Return whether two states are recorded the same, every field being compared
+// bit for bit and the padding of struct sim being left out.
+bool is_same_recorded_state(const struct sim *a, const struct sim *b) {
+    uint8_t a_bytes[RECORDING_STATE_LENGTH];
+    uint8_t b_bytes[RECORDING_STATE_LENGTH];
+    put_state(a_bytes, a);
+    put_state(b_bytes, b);
+    return memcmp(a_bytes, b_bytes, RECORDING_STATE_LENGTH) == 0;
+}
+
+static void write_bytes(struct recorder *recorder, const void *bytes,
+                        size_t length) {
+    if (fwrite(bytes, 1, length, recorder->file) != length) {
+        recorder->failed = true;
+    }
+    recorder->offset += length;
+}
+
+static void write_f32(struct recorder *recorder, float value) {
+    uint8_t bytes[4];
+    put_f32(bytes, value);
+    write_bytes(recorder, bytes, 4);
+}
+
+static void write_state(struct recorder *recorder, const struct sim *sim) {
+    uint8_t bytes[RECORDING_STATE_LENGTH];
+    put_state(bytes, sim);
+    write_bytes(recorder, bytes, RECORDING_STATE_LENGTH);
+}
+
+// Write an unsigned integer 7 bits at a time, least significant first, with
+// the high bit of every byte but the last set.
+static void write_varint(struct recorder *recorder, uint64_t value) {
+    uint8_t bytes[10];
+    size_t length = 0;
+    do {
+        bytes[length] = value & 0x7f;
+        value >>= 7;
+        if (value > 0) {
+            bytes[length] |= 0x80;
+        }
+        length++;
+    } while (value > 0);
+    write_bytes(recorder, bytes, length);
+}
+
+static uint8_t get_input_flags(struct tick_input input) {
+    return (input.ghost_1_active ? GHOST_1_ACTIVE : 0) |
+           (input.ghost_2_active ? GHOST_2_ACTIVE : 0);
+}
+
+// Write the entry ending the run of the current inputs, changing them to the
+// given ones, and the state too if it isn't NULL.
+static void write_entry(struct recorder *recorder, struct tick_input input,
+                        const struct sim *sim) {
+    uint8_t flags = get_input_flags(input);
+    if (input.paddle_1_velocity != recorder->input.paddle_1_velocity) {
+        flags |= PADDLE_1_VELOCITY;
+    }
+    if (input.paddle_2_velocity != recorder->input.paddle_2_velocity) {
+        flags |= PADDLE_2_VELOCITY;
+    }
+    if (sim != NULL) {
+        flags |= STATE;
+    }
+
+    write_varint(recorder, recorder->run);
+    write_bytes(recorder, &flags, 1);
+    if (flags & PADDLE_1_VELOCITY) {
+        write_f32(recorder, input.paddle_1_velocity);
+    }
+    if (flags & PADDLE_2_VELOCITY) {
+        write_f32(recorder, input.paddle_2_velocity);
+    }
+    if (flags & STATE) {
+        write_state(recorder, sim);
+    }
+
+    recorder->input = input;
+    recorder->run = 0;
+}
+
+// Start recording to a file from the given state. Return false if the file
+// couldn't be created.
+bool open_recorder(struct recorder *recorder, const char *path,
+                   const struct sim *sim, uint64_t seed, int tick_rate) {
+    *recorder = (struct recorder){
+        .file = fopen(path, "wb"),
+        .keyframe_interval = RECORDING_KEYFRAME_PERIOD * tick_rate,
+        .input = get_tick_input(sim),
+        .sim = *sim,
+    };
+    if (recorder->file == NULL) {
+        return false;
+    }
+
+    uint8_t header[HEADER_LENGTH];
+    memcpy(header, HEADER_MAGIC, 8);
+    put_u32(header + 8, RECORDING_VERSION);
+    put_u32(header + 12, RECORDING_STATE_LENGTH);
+    put_u32(header + 16, tick_rate);
+    put_u32(header + 20, recorder->keyframe_interval);
+    put_u64(header + 24, seed);
+    write_bytes(recorder, header, HEADER_LENGTH);
+    write_state(recorder, sim);
+    return true;
+}
+
+// Record the state of the simulation right before a tick. Only the inputs are
+// written when they change, unless the state was changed since the last tick
+// otherwise than by the inputs.
+void begin_recorded_tick(struct recorder *recorder, const struct sim *sim) {
+    struct tick_input input = get_tick_input(sim);
+
+    struct sim expected = recorder->sim;
+    apply_tick_input(&expected, input);
+    // The events are only there to be handled by the game.
+    expected.events = sim->events;
+    bool state_changed = !is_same_recorded_state(&expected, sim);
+
+    if (state_changed ||
+        get_input_flags(input) != get_input_flags(recorder->input) ||
+        input.paddle_1_velocity != recorder->input.paddle_1_velocity ||
+        input.paddle_2_velocity != recorder->input.paddle_2_velocity) {
+        write_entry(recorder, input, state_changed ? sim : NULL);
+    }
+    recorder->run++;
+}
+
+// Record the state of the simulation right after a tick, keeping a keyframe
+// of it every keyframe interval.
+void end_recorded_tick(struct recorder *recorder, const struct sim *sim) {
+    recorder->sim = *sim;
+    recorder->ticks++;
+    if (recorder->ticks % recorder->keyframe_interval != 0) {
+        return;
+    }
+
+    // The stream is resumed from the keyframe at the start of an entry.
+    write_entry(recorder, recorder->input, NULL);
+
+    if (recorder->keyframes_length == recorder->keyframes_capacity) {
+        size_t capacity = recorder->keyframes_capacity * 2;
+        if (capacity == 0) {
+            capacity = 64;
+        }
+        struct keyframe *keyframes =
+            realloc(recorder->keyframes, capacity * sizeof(struct keyframe));
+        if (keyframes == NULL) {
+            // The recording can still be played, only seeking gets slower.
+            return;
+        }
+        recorder->keyframes = keyframes;
+        recorder->keyframes_capacity = capacity;
+    }
+    recorder->keyframes[recorder->keyframes_length++] = (struct keyframe){
+        .tick = recorder->ticks,
+        .offset = recorder->offset,
+        .sim = *sim,
+    };
+}
+
+// Write the index of the keyframes and close the file. Return false if
+// anything failed to be written.
+bool close_recorder(struct recorder *recorder) {
+    if (recorder->run > 0) {
+        write_entry(recorder, recorder->input, NULL);
+    }
+
+    uint64_t index_offset = recorder->offset;
+    for (size_t i = 0; i < recorder->keyframes_length; i++) {
+        struct keyframe *keyframe = &recorder->keyframes[i];
+        uint8_t bytes[16];
+        put_u64(bytes, keyframe->tick);
+        put_u64(bytes + 8, keyframe->offset);
+        write_bytes(recorder, bytes, 16);
+        write_state(recorder, &keyframe->sim);
+    }
+
+    uint8_t trailer[TRAILER_LENGTH];
+    put_u64(trailer, index_offset);
+    put_u64(trailer + 8, recorder->keyframes_length);
+    put_u64(trailer + 16, recorder->ticks);
+    memcpy(trailer + 24, TRAILER_MAGIC, 8);
+    write_bytes(recorder, trailer, TRAILER_LENGTH);
+
+    if (fclose(recorder->file) != 0) {
+        recorder->failed = true;
+    }
+    free(recorder->keyframes);
+    return !recorder->failed;
+}
+
+// Rewind the replay to the state the recording started from.
+static void rewind_replay(struct replay *replay) {
+    replay->sim = get_state(replay->data + HEADER_LENGTH);
+    replay->tick = 0;
+    replay->offset = HEADER_LENGTH + RECORDING_STATE_LENGTH;
+    replay->input = get_tick_input(&replay->sim);
+    replay->run = 0;
+    replay->change_pending = false;
+}
+
+// Open a recording held in memory, which must stay there for as long as it is
+// played. A recording that was never closed has no index and can only be
+// played from the start, up to the last change of the inputs. Return false if
+// it isn't a recording this build can play.
+bool open_replay(struct replay *replay, const void *data, size_t size) {
+    const uint8_t *bytes = data;
+    size_t stream_start = HEADER_LENGTH + RECORDING_STATE_LENGTH;
+    if (size < stream_start || memcmp(bytes, HEADER_MAGIC, 8) != 0 ||
+        get_u32(bytes + 8) != RECORDING_VERSION ||
+        get_u32(bytes + 12) != RECORDING_STATE_LENGTH ||
+        get_u32(bytes + 16) == 0) {
+        return false;
+    }
+    *replay = (struct replay){
+        .data = bytes,
+        .size = size,
+        .seed = get_u64(bytes + 24),
+        .tick_rate = get_u32(bytes + 16),
+        .keyframe_interval = get_u32(bytes + 20),
+        .ticks = -1,
+        .stream_end = size,
+    };
+
+    if (size >= stream_start + TRAILER_LENGTH) {
+        const uint8_t *trailer = bytes + size - TRAILER_LENGTH;
+        uint64_t index_offset = get_u64(trailer);
+        uint64_t keyframes_length = get_u64(trailer + 8);
+        if (memcmp(trailer + 24, TRAILER_MAGIC, 8) == 0 &&
+            index_offset >= stream_start &&
+            index_offset <= size - TRAILER_LENGTH &&
+            keyframes_length ==
+                (size - TRAILER_LENGTH - index_offset) / KEYFRAME_LENGTH) {
+            replay->ticks = get_u64(trailer + 16);
+            replay->keyframes_offset = index_offset;
+            replay->keyframes_length = keyframes_length;
+            replay->stream_end = index_offset;
+        }
+    }
+
+    rewind_replay(replay);
+    return true;
+}
+
+static const uint8_t *get_keyframe_bytes(const struct replay *replay,
+                                         size_t index) {
+    return replay->data + replay->keyframes_offset + index * KEYFRAME_LENGTH;
+}
+
+struct keyframe get_replay_keyframe(const struct replay *replay,
+                                    size_t index) {
+    const uint8_t *bytes = get_keyframe_bytes(replay, index);
+    return (struct keyframe){
+        .tick = get_u64(bytes),
+        .offset = get_u64(bytes + 8),
+        .sim = get_state(bytes + 16),
+    };
+}
+
+static bool read_bytes(struct replay *replay, void *bytes, size_t length) {
+    if (replay->offset > replay->stream_end ||
+        replay->stream_end - replay->offset < length) {
+        return false;
+    }
+    memcpy(bytes, replay->data + replay->offset, length);
+    replay->offset += length;
+    return true;
+}
+
+static bool read_varint(struct replay *replay, uint64_t *value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t byte;
+        if (!read_bytes(replay, &byte, 1)) {
+            return false;
+        }
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Apply the change of the inputs, and maybe of the state, of the entry whose
+// run is over.
+static bool read_change(struct replay *replay) {
+    uint8_t flags;
+    if (!read_bytes(replay, &flags, 1)) {
+        return false;
+    }
+    struct tick_input input = replay->input;
+    input.ghost_1_active = flags & GHOST_1_ACTIVE;
+    input.ghost_2_active = flags & GHOST_2_ACTIVE;
+    uint8_t bytes[RECORDING_STATE_LENGTH];
+    if (flags & PADDLE_1_VELOCITY) {
+        if (!read_bytes(replay, bytes, 4)) {
+            return false;
+        }
+        input.paddle_1_velocity = get_f32(bytes);
+    }
+    if (flags & PADDLE_2_VELOCITY) {
+        if (!read_bytes(replay, bytes, 4)) {
+            return false;
+        }
+        input.paddle_2_velocity = get_f32(bytes);
+    }
+    if (flags & STATE) {
+        if (!read_bytes(replay, bytes, RECORDING_STATE_LENGTH)) {
+            return false;
+        }
+        replay->sim = get_state(bytes);
+    }
+    replay->input = input;
+    return true;
+}
+
+// Simulate the next tick of the recording. Return false at its end.
+bool step_replay(struct replay *replay) {
+    while (replay->run == 0) {
+        if (replay->change_pending && !read_change(replay)) {
+            return false;
+        }
+        uint64_t run;
+        if (!read_varint(replay, &run)) {
+            return false;
+        }
+        replay->run = run;
+        replay->change_pending = true;
+    }
+    replay->run--;
+
+    apply_tick_input(&replay->sim, replay->input);
+    update_ghosts(&replay->sim);
+    update_sim(&replay->sim, 1.0 / replay->tick_rate);
+    replay->events = replay->sim.events;
+    replay->sim.events = (struct sim_events){0};
+    replay->tick++;
+    return true;
+}
+
+// Move the replay to the end of the given tick, from the closest keyframe
+// before it unless the replay is already between the two. The keyframe is
+// found by a binary search of the index. Return false if the recording ends
+// before the tick.
+bool seek_replay(struct replay *replay, int64_t tick) {
+    size_t low = 0;
+    size_t high = replay->keyframes_length;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        int64_t middle_tick = get_u64(get_keyframe_bytes(replay, middle));
+        if (middle_tick <= tick) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if (low > 0) {
+        struct keyframe keyframe = get_replay_keyframe(replay, low - 1);
+        if (replay->tick < keyframe.tick || replay->tick > tick) {
+            replay->sim = keyframe.sim;
+            replay->tick = keyframe.tick;
+            replay->offset = keyframe.offset;
+            replay->input = get_tick_input(&keyframe.sim);
+            replay->run = 0;
+            replay->change_pending = false;
+        }
+    } else if (replay->tick > tick) {
+        rewind_replay(replay);
+    }
+
+    while (replay->tick < tick) {
+        if (!step_replay(replay)) {
+            return false;
+        }
+    }
+    return true;
+}
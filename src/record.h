@@ -0,0 +1,100 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "sim.h"
+
+// Recordings of matches, made of the state the simulation started from and of
+// what the players did on every tick, from which any moment of a match can be
+// simulated again. Nothing in here may depend on SDL so that recordings can be
+// played headless.
+//
+// A recording is laid out as:
+//
+//   header   magic, version, length of a state, tick rate, keyframe interval
+//            and seed, followed by the state the simulation started from
+//   stream   an entry per change of the inputs: the number of ticks the
+//            previous inputs lasted as a varint, a flags byte, the velocities
+//            of the paddles of the players that changed, and the whole state
+//            when it was changed between ticks, by a restart or a cheat
+//   index    a keyframe every keyframe interval: its tick, the offset in the
+//            stream it resumes from and the state at the end of the tick
+//   trailer  offset of the index, number of keyframes and of ticks, magic
+//
+// Integers and floats are little-endian, and the states are written field by
+// field in the order of struct sim, booleans taking a byte, so that recordings
+// don't depend on the layout of struct sim in memory.
+
+#define RECORDING_VERSION 2
+#define RECORDING_STATE_LENGTH 205 // in bytes
+#define RECORDING_KEYFRAME_PERIOD 10 // in seconds
+
+// What the players do during a tick, which together with the state of the
+// simulation is all that the tick depends on.
+struct tick_input {
+    bool ghost_1_active;
+    bool ghost_2_active;
+    // The velocities of the paddles whose ghost isn't active, otherwise 0.
+    float paddle_1_velocity;
+    float paddle_2_velocity;
+};
+
+struct keyframe {
+    int64_t tick;
+    uint64_t offset; // in the file, of the entry of the stream that follows
+    struct sim sim;
+};
+
+struct recorder {
+    FILE *file;
+    bool failed; // to write
+    int keyframe_interval; // in ticks
+    uint64_t offset;       // of the end of the file
+    int64_t ticks;
+    struct tick_input input;
+    int64_t run;    // ticks of the same inputs yet to be written
+    struct sim sim; // at the end of the last tick
+    struct keyframe *keyframes;
+    size_t keyframes_length;
+    size_t keyframes_capacity;
+};
+
+// A recording being played from memory, usually a mapped file. The state is
+// the one at the end of the given number of ticks.
+struct replay {
+    const uint8_t *data;
+    size_t size;
+    uint64_t seed;
+    int tick_rate;
+    int keyframe_interval; // in ticks
+    int64_t ticks; // recorded, or -1 if the recording was never closed
+    size_t keyframes_offset;
+    size_t keyframes_length;
+    size_t stream_end;
+
+    struct sim sim;
+    struct sim_events events; // of the last tick stepped
+    int64_t tick;
+    size_t offset;           // of the next entry of the stream to read
+    struct tick_input input; // of the ticks to come
+    int64_t run;             // ticks left with the same inputs
+    bool change_pending;     // when the run is over
+};
+
+bool is_same_recorded_state(const struct sim *a, const struct sim *b);
+struct tick_input get_tick_input(const struct sim *sim);
+void apply_tick_input(struct sim *sim, struct tick_input input);
+
+bool open_recorder(struct recorder *recorder, const char *path,
+                   const struct sim *sim, uint64_t seed, int tick_rate);
+void begin_recorded_tick(struct recorder *recorder, const struct sim *sim);
+void end_recorded_tick(struct recorder *recorder, const struct sim *sim);
+bool close_recorder(struct recorder *recorder);
+
+bool open_replay(struct replay *replay, const void *data, size_t size);
+struct keyframe get_replay_keyframe(const struct replay *replay,
+                                    size_t index);
+bool step_replay(struct replay *replay);
+bool seek_replay(struct replay *replay, int64_t tick);
@@ -1,5 +1,9 @@
 #include "renderer.h"
 
+static void fill_rects(struct renderer_wrapper *wrapper,
+                       const struct draw_list *list);
+static void draw_background(struct renderer_wrapper *wrapper);
+
 static void update_renderer_wrapper(struct renderer_wrapper *wrapper) {
     SDL_GetRendererOutputSize(wrapper->renderer, &wrapper->output_size.w,
                               &wrapper->output_size.h);
@@ -14,6 +18,8 @@ static void update_renderer_wrapper(struct renderer_wrapper *wrapper) {
         (wrapper->output_size.w - (wrapper->viewport.w)) / 2.0;
     wrapper->viewport.y =
         (wrapper->output_size.h - (wrapper->viewport.h)) / 2.0;
+
+    wrapper->background_valid = false;
 }
 
 struct renderer_wrapper make_renderer_wrapper(SDL_Renderer *renderer,
@@ -28,9 +34,17 @@ struct renderer_wrapper make_renderer_wrapper(SDL_Renderer *renderer,
             },
     };
     update_renderer_wrapper(&wrapper);
+    clear_draw_list(&wrapper.background, (struct color){0, 0, 0, 255});
     return wrapper;
 }
 
+void destroy_renderer_wrapper(struct renderer_wrapper *wrapper) {
+    if (wrapper->background_texture != NULL) {
+        SDL_DestroyTexture(wrapper->background_texture);
+        wrapper->background_texture = NULL;
+    }
+}
+
 int renderer_wrapper_event_watch(void *userdata, SDL_Event *event) {
     struct renderer_wrapper *wrapper = (struct renderer_wrapper *)userdata;
 
@@ -39,6 +53,10 @@ int renderer_wrapper_event_watch(void *userdata, SDL_Event *event) {
         if (event->window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
             update_renderer_wrapper(wrapper);
         }
+    } else if (event->type == SDL_RENDER_TARGETS_RESET ||
+               event->type == SDL_RENDER_DEVICE_RESET) {
+        // The contents of the background texture are lost.
+        wrapper->background_valid = false;
     } else if (event->type == SDL_FINGERDOWN || event->type == SDL_FINGERUP ||
                event->type == SDL_FINGERMOTION) {
         if (wrapper->output_size.w == 0.0f) {
@@ -81,13 +99,109 @@ int renderer_wrapper_event_watch(void *userdata, SDL_Event *event) {
     return 0;
 }
 
-SDL_FRect renderer_wrapper_scale_frect(struct renderer_wrapper wrapper,
+SDL_FRect renderer_wrapper_scale_frect(const struct renderer_wrapper *wrapper,
                                        SDL_FRect rect) {
-    rect.x *= wrapper.scale;
-    rect.y *= wrapper.scale;
-    rect.w *= wrapper.scale;
-    rect.h *= wrapper.scale;
-    rect.x += wrapper.viewport.x;
-    rect.y += wrapper.viewport.y;
+    rect.x *= wrapper->scale;
+    rect.y *= wrapper->scale;
+    rect.w *= wrapper->scale;
+    rect.h *= wrapper->scale;
+    rect.x += wrapper->viewport.x;
+    rect.y += wrapper->viewport.y;
     return rect;
 }
+
+// Replace the background every frame is drawn over, whose clear color is the
+// one of the frames.
+void renderer_wrapper_set_background(struct renderer_wrapper *wrapper,
+                                     const struct draw_list *list) {
+    wrapper->background = *list;
+    wrapper->background_valid = false;
+}
+
+// Draw the background and fill the rectangles of the list over it, with a
+// single call per run of rectangles of the same color.
+void renderer_wrapper_draw(struct renderer_wrapper *wrapper,
+                           const struct draw_list *list) {
+    if (!wrapper->background_valid) {
+        draw_background(wrapper);
+    }
+
+    if (wrapper->background_valid) {
+        SDL_RenderCopy(wrapper->renderer, wrapper->background_texture, NULL,
+                       NULL);
+    } else {
+        // Without render targets the background is drawn like any other
+        // rectangles.
+        struct color c = wrapper->background.clear_color;
+        SDL_SetRenderDrawColor(wrapper->renderer, c.r, c.g, c.b, c.a);
+        SDL_RenderClear(wrapper->renderer);
+        fill_rects(wrapper, &wrapper->background);
+    }
+
+    fill_rects(wrapper, list);
+}
+
+// Draw the background into a texture the size of the output, if possible.
+static void draw_background(struct renderer_wrapper *wrapper) {
+    if (!SDL_RenderTargetSupported(wrapper->renderer)) {
+        return;
+    }
+
+    int w = 0;
+    int h = 0;
+    if (wrapper->background_texture != NULL) {
+        SDL_QueryTexture(wrapper->background_texture, NULL, NULL, &w, &h);
+    }
+    if (w != wrapper->output_size.w || h != wrapper->output_size.h) {
+        if (wrapper->background_texture != NULL) {
+            SDL_DestroyTexture(wrapper->background_texture);
+        }
+        wrapper->background_texture = SDL_CreateTexture(
+            wrapper->renderer, SDL_PIXELFORMAT_RGBA8888,
+            SDL_TEXTUREACCESS_TARGET, wrapper->output_size.w,
+            wrapper->output_size.h);
+        if (wrapper->background_texture == NULL) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Couldn't create the background texture: %s",
+                         SDL_GetError());
+            return;
+        }
+        // The background is opaque and replaces whatever is below it.
+        SDL_SetTextureBlendMode(wrapper->background_texture,
+                                SDL_BLENDMODE_NONE);
+    }
+
+    if (SDL_SetRenderTarget(wrapper->renderer,
+                            wrapper->background_texture) < 0) {
+        return;
+    }
+    struct color c = wrapper->background.clear_color;
+    SDL_SetRenderDrawColor(wrapper->renderer, c.r, c.g, c.b, c.a);
+    SDL_RenderClear(wrapper->renderer);
+    fill_rects(wrapper, &wrapper->background);
+    SDL_SetRenderTarget(wrapper->renderer, NULL);
+    wrapper->background_valid = true;
+}
+
+// Fill the rectangles of the list in their order, like the software
+// rasterizer does, with a single call per run of rectangles of the same color.
+static void fill_rects(struct renderer_wrapper *wrapper,
+                       const struct draw_list *list) {
+    static SDL_FRect rects[DRAW_LIST_MAX_RECTS];
+
+    int start = 0;
+    while (start < list->rects_length) {
+        int color = list->rect_colors[start];
+        int rects_length = 0;
+        for (int i = start;
+             i < list->rects_length && list->rect_colors[i] == color; i++) {
+            struct rect r = list->rects[i];
+            SDL_FRect rect = {.x = r.x, .y = r.y, .w = r.w, .h = r.h};
+            rects[rects_length++] = renderer_wrapper_scale_frect(wrapper, rect);
+        }
+        struct color c = list->colors[color];
+        SDL_SetRenderDrawColor(wrapper->renderer, c.r, c.g, c.b, c.a);
+        SDL_RenderFillRectsF(wrapper->renderer, rects, rects_length);
+        start += rects_length;
+    }
+}
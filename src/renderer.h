@@ -2,6 +2,8 @@
 
 #include <SDL.h>
 
+#include "draw.h"
+
 // NOTE: Ditch this when SDL_RenderSetLogicalSize works correctly in the SDL
 // Emscripten port when the game is made fullscreen.
 struct renderer_wrapper {
@@ -10,11 +12,22 @@ struct renderer_wrapper {
     SDL_Rect logical_size;
     SDL_Rect viewport;
     float scale;
+    // The part of every frame that rarely changes, which is drawn into a
+    // texture when the renderer supports it and redrawn only when it changes
+    // or the size of the output does.
+    struct draw_list background;
+    SDL_Texture *background_texture;
+    bool background_valid;
 };
 
 struct renderer_wrapper make_renderer_wrapper(SDL_Renderer *renderer,
                                               int logical_width,
                                               int logical_height);
+void destroy_renderer_wrapper(struct renderer_wrapper *wrapper);
 int renderer_wrapper_event_watch(void *userdata, SDL_Event *event);
-SDL_FRect renderer_wrapper_scale_frect(struct renderer_wrapper wrapper,
+SDL_FRect renderer_wrapper_scale_frect(const struct renderer_wrapper *wrapper,
                                        SDL_FRect rect);
+void renderer_wrapper_set_background(struct renderer_wrapper *wrapper,
+                                     const struct draw_list *list);
+void renderer_wrapper_draw(struct renderer_wrapper *wrapper,
+                           const struct draw_list *list);
@@ -0,0 +1,123 @@
+#include "rewind.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// How long a replay shows before the serve of the rally.
+#define LEAD_IN_DURATION 0.5 // in seconds
+
+// Allocate a buffer of the given number of ticks. Return false if it couldn't
+// be, in which case nothing is ever kept.
+bool init_rewind_buffer(struct rewind_buffer *buffer, int capacity) {
+    *buffer = (struct rewind_buffer){
+        .snapshots = malloc(capacity * sizeof(struct sim)),
+        .capacity = capacity,
+    };
+    if (buffer->snapshots == NULL) {
+        buffer->capacity = 0;
+        return false;
+    }
+    return true;
+}
+
+void destroy_rewind_buffer(struct rewind_buffer *buffer) {
+    free(buffer->snapshots);
+    *buffer = (struct rewind_buffer){0};
+}
+
+// Keep the state at the end of a tick, in place of the oldest one once the
+// buffer is full.
+void push_rewind_snapshot(struct rewind_buffer *buffer,
+                          const struct sim *sim) {
+    if (buffer->capacity == 0) {
+        return;
+    }
+    buffer->ticks++;
+    memcpy(&buffer->snapshots[buffer->ticks % buffer->capacity], sim,
+           sizeof(struct sim));
+    if (buffer->length < buffer->capacity) {
+        buffer->length++;
+    }
+}
+
+// Return the state at the end of the given tick, or NULL if it isn't held.
+const struct sim *get_rewind_snapshot(const struct rewind_buffer *buffer,
+                                      int64_t tick) {
+    if (tick > buffer->ticks || tick <= buffer->ticks - buffer->length) {
+        return NULL;
+    }
+    return &buffer->snapshots[tick % buffer->capacity];
+}
+
+static bool is_point_scored(const struct rewind_buffer *buffer, int64_t tick) {
+    const struct sim *sim = get_rewind_snapshot(buffer, tick);
+    const struct sim *previous = get_rewind_snapshot(buffer, tick - 1);
+    return sim->paddle_1.score != previous->paddle_1.score ||
+           sim->paddle_2.score != previous->paddle_2.score;
+}
+
+// Start replaying the last rally held at the given speed, from a little before
+// its serve up to the last tick before the point was scored, or up to now if
+// it's still being played. Return false if there is nothing to replay.
+bool start_instant_replay(struct instant_replay *replay,
+                          const struct rewind_buffer *buffer, double speed) {
+    int64_t first_tick = buffer->ticks - buffer->length + 1;
+    if (buffer->length < 2) {
+        return false;
+    }
+
+    // Scanning the buffer is only done once per replay, so the ticks don't
+    // have to keep track of the rallies.
+    int64_t end_tick = buffer->ticks;
+    for (int64_t tick = buffer->ticks; tick > first_tick; tick--) {
+        if (is_point_scored(buffer, tick)) {
+            end_tick = tick - 1;
+            break;
+        }
+    }
+    int64_t start_tick = end_tick;
+    while (start_tick > first_tick &&
+           get_rewind_snapshot(buffer, start_tick - 1)->ball.served &&
+           !is_point_scored(buffer, start_tick)) {
+        start_tick--;
+    }
+    const struct sim *start = get_rewind_snapshot(buffer, start_tick);
+    const struct sim *next = get_rewind_snapshot(buffer, start_tick + 1);
+    if (next != NULL && next->time > start->time) {
+        double tick_duration = next->time - start->time;
+        start_tick -= (int64_t)(LEAD_IN_DURATION / tick_duration);
+    }
+    if (start_tick < first_tick) {
+        start_tick = first_tick;
+    }
+    if (start_tick >= end_tick) {
+        return false;
+    }
+
+    *replay = (struct instant_replay){
+        .active = true,
+        .position = start_tick,
+        .end_tick = end_tick,
+        .speed = speed,
+    };
+    return true;
+}
+
+// Move the replay forward by the given number of ticks of the simulation, and
+// get the state to show, placed between the two ticks the replay is at. The
+// replay ends when it reaches its last tick, and false is returned.
+bool update_instant_replay(struct instant_replay *replay,
+                           const struct rewind_buffer *buffer, double ticks,
+                           struct sim *sim) {
+    replay->position += ticks * replay->speed;
+    if (replay->position >= replay->end_tick) {
+        replay->active = false;
+        return false;
+    }
+    int64_t tick = floor(replay->position);
+    *sim = interpolate_sim(get_rewind_snapshot(buffer, tick),
+                           get_rewind_snapshot(buffer, tick + 1),
+                           replay->position - tick);
+    return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+// The last seconds of the simulation kept in memory to be replayed instantly.
+// Nothing in here may depend on SDL.
+
+#define REWIND_DURATION 10 // in seconds
+
+// A ring of the states at the end of the last ticks, allocated once, which
+// every tick only copies its state into.
+struct rewind_buffer {
+    struct sim *snapshots;
+    int capacity;
+    int length;
+    int64_t ticks; // pushed since the start, the last one being held
+};
+
+// The replay of part of the buffer, the buffer being left as it is meanwhile.
+struct instant_replay {
+    bool active;
+    double position; // in ticks, between two of them when slowed down
+    int64_t end_tick;
+    double speed; // relative to the simulation
+};
+
+bool init_rewind_buffer(struct rewind_buffer *buffer, int capacity);
+void destroy_rewind_buffer(struct rewind_buffer *buffer);
+void push_rewind_snapshot(struct rewind_buffer *buffer,
+                          const struct sim *sim);
+const struct sim *get_rewind_snapshot(const struct rewind_buffer *buffer,
+                                      int64_t tick);
+bool start_instant_replay(struct instant_replay *replay,
+                          const struct rewind_buffer *buffer, double speed);
+bool update_instant_replay(struct instant_replay *replay,
+                           const struct rewind_buffer *buffer, double ticks,
+                           struct sim *sim);
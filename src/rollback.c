@@ -0,0 +1,238 @@
+#include "rollback.h"
+
+#include <string.h>
+
+#include "record.h"
+
+static const char PACKET_MAGIC[4] = "TNSN";
+
+enum {
+    PACKET_HEADER_LENGTH = 28,
+};
+
+// The players of the peers play every tick, their ghosts never take over.
+void init_rollback(struct rollback *rollback, uint64_t seed, int tick_rate,
+                   int local_no) {
+    *rollback = (struct rollback){
+        .seed = seed,
+        .tick_rate = tick_rate,
+        .local_no = local_no,
+        .sim = make_sim(seed),
+        .rollback_tick = -1,
+    };
+    rollback->sim.ghost_1.active = false;
+    rollback->sim.ghost_2.active = false;
+}
+
+// The remote player is predicted to keep doing what they last did.
+static float predict_remote_input(const struct rollback *rollback) {
+    if (rollback->remote_ticks == 0) {
+        return 0.0f;
+    }
+    int64_t last_tick = rollback->remote_ticks - 1;
+    return rollback->remote_inputs[last_tick % ROLLBACK_INPUTS_LENGTH];
+}
+
+static void simulate_tick(struct rollback *rollback) {
+    int64_t tick = rollback->tick;
+    rollback->snapshots[tick % ROLLBACK_WINDOW] = rollback->sim;
+
+    float local = rollback->local_inputs[tick % ROLLBACK_INPUTS_LENGTH];
+    float remote = rollback->remote_inputs[tick % ROLLBACK_INPUTS_LENGTH];
+    struct tick_input input = {
+        .paddle_1_velocity = (rollback->local_no == 1) ? local : remote,
+        .paddle_2_velocity = (rollback->local_no == 1) ? remote : local,
+    };
+    apply_tick_input(&rollback->sim, input);
+    update_ghosts(&rollback->sim);
+    update_sim(&rollback->sim, 1.0 / rollback->tick_rate);
+    rollback->tick++;
+}
+
+// Simulate the next tick with the given local input. Return false without
+// simulating it if the remote inputs are too far behind to be rolled back to,
+// or if the local ones haven't been acknowledged for too long.
+bool step_rollback(struct rollback *rollback, float local_velocity) {
+    int64_t tick = rollback->tick;
+    if (tick - rollback->remote_ticks >= ROLLBACK_WINDOW ||
+        tick - rollback->local_acked >= ROLLBACK_INPUTS_LENGTH) {
+        return false;
+    }
+
+    rollback->local_inputs[tick % ROLLBACK_INPUTS_LENGTH] = local_velocity;
+    if (tick >= rollback->remote_ticks) {
+        rollback->remote_inputs[tick % ROLLBACK_INPUTS_LENGTH] =
+            predict_remote_input(rollback);
+    }
+    simulate_tick(rollback);
+    return true;
+}
+
+// Simulate again the ticks since the first one that was simulated with a
+// wrong prediction, if any. The events of those ticks were already reported,
+// so the ones they have this time are dropped.
+void update_rollback(struct rollback *rollback) {
+    if (rollback->rollback_tick < 0) {
+        return;
+    }
+    int64_t end_tick = rollback->tick;
+    struct sim_events events = rollback->sim.events;
+
+    rollback->tick = rollback->rollback_tick;
+    rollback->sim = rollback->snapshots[rollback->tick % ROLLBACK_WINDOW];
+    while (rollback->tick < end_tick) {
+        simulate_tick(rollback);
+    }
+    rollback->sim.events = events;
+
+    int ticks = end_tick - rollback->rollback_tick;
+    rollback->rollbacks++;
+    rollback->resimulated_ticks += ticks;
+    if (ticks > rollback->max_rollback_ticks) {
+        rollback->max_rollback_ticks = ticks;
+    }
+    rollback->rollback_tick = -1;
+}
+
+// Return the state at the start of the last tick, to interpolate from.
+struct sim get_rollback_previous_sim(const struct rollback *rollback) {
+    if (rollback->tick == 0) {
+        return rollback->sim;
+    }
+    return rollback->snapshots[(rollback->tick - 1) % ROLLBACK_WINDOW];
+}
+
+static void put_u32(uint8_t *bytes, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        bytes[i] = value >> (8 * i);
+    }
+}
+
+static uint32_t get_u32(const uint8_t *bytes) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        value |= (uint32_t)bytes[i] << (8 * i);
+    }
+    return value;
+}
+
+static void put_float(uint8_t *bytes, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(float));
+    put_u32(bytes, bits);
+}
+
+static float get_float(const uint8_t *bytes) {
+    uint32_t bits = get_u32(bytes);
+    float value;
+    memcpy(&value, &bits, sizeof(float));
+    return value;
+}
+
+// Write a packet of every local input the other peer hasn't acknowledged, so
+// that lost packets don't need to be sent again, together with how many
+// remote inputs were received. Return its length, of at most
+// ROLLBACK_MAX_PACKET_LENGTH.
+//
+// A packet is made of a magic, the seed and the tick rate of the session, the
+// number of remote inputs received, the tick of the first input, the number
+// of inputs, then the inputs, all little-endian.
+size_t write_rollback_packet(const struct rollback *rollback,
+                             uint8_t *packet) {
+    int64_t start_tick = rollback->local_acked;
+    int count = rollback->tick - start_tick;
+
+    memcpy(packet, PACKET_MAGIC, 4);
+    put_u32(packet + 4, rollback->seed);
+    put_u32(packet + 8, rollback->seed >> 32);
+    put_u32(packet + 12, rollback->tick_rate);
+    put_u32(packet + 16, rollback->remote_ticks);
+    put_u32(packet + 20, start_tick);
+    put_u32(packet + 24, count);
+    for (int i = 0; i < count; i++) {
+        int64_t tick = start_tick + i;
+        put_float(packet + PACKET_HEADER_LENGTH + i * 4,
+                  rollback->local_inputs[tick % ROLLBACK_INPUTS_LENGTH]);
+    }
+    return PACKET_HEADER_LENGTH + count * 4;
+}
+
+// Get the seed and the tick rate of the session a packet belongs to. Return
+// false if it isn't a packet of a session.
+bool get_rollback_packet_session(const uint8_t *packet, size_t length,
+                                 uint64_t *seed, int *tick_rate) {
+    if (length < PACKET_HEADER_LENGTH ||
+        memcmp(packet, PACKET_MAGIC, 4) != 0 ||
+        get_u32(packet + 24) > ROLLBACK_INPUTS_LENGTH ||
+        length != PACKET_HEADER_LENGTH + get_u32(packet + 24) * 4) {
+        return false;
+    }
+    *seed = get_u32(packet + 4) | (uint64_t)get_u32(packet + 8) << 32;
+    *tick_rate = get_u32(packet + 12);
+    return true;
+}
+
+// Mark the ticks from the given one as simulated with a wrong prediction.
+static void mark_rollback(struct rollback *rollback, int64_t tick) {
+    if (rollback->rollback_tick < 0 || tick < rollback->rollback_tick) {
+        rollback->rollback_tick = tick;
+    }
+}
+
+// Read the remote inputs of a packet that follow the ones already received,
+// and mark the ticks they were mispredicted for to be simulated again. Return
+// false if it isn't a packet of this session.
+bool read_rollback_packet(struct rollback *rollback, const uint8_t *packet,
+                          size_t length) {
+    uint64_t seed;
+    int tick_rate;
+    if (!get_rollback_packet_session(packet, length, &seed, &tick_rate) ||
+        seed != rollback->seed || tick_rate != rollback->tick_rate) {
+        return false;
+    }
+
+    // Packets may arrive out of order.
+    int64_t acked = get_u32(packet + 16);
+    if (acked > rollback->local_acked && acked <= rollback->tick) {
+        rollback->local_acked = acked;
+    }
+
+    int64_t start_tick = get_u32(packet + 20);
+    int count = get_u32(packet + 24);
+    int64_t old_remote_ticks = rollback->remote_ticks;
+    for (int i = 0; i < count; i++) {
+        int64_t tick = start_tick + i;
+        if (tick < rollback->remote_ticks) {
+            continue;
+        }
+        // The remote peer can't be more than a window ahead, and its inputs
+        // must not overwrite the ones that may still be simulated again.
+        if (tick > rollback->remote_ticks ||
+            tick >= rollback->tick + ROLLBACK_WINDOW) {
+            break;
+        }
+        float input = get_float(packet + PACKET_HEADER_LENGTH + i * 4);
+        float *slot = &rollback->remote_inputs[tick % ROLLBACK_INPUTS_LENGTH];
+        if (tick < rollback->tick && *slot != input) {
+            mark_rollback(rollback, tick);
+        }
+        *slot = input;
+        rollback->remote_ticks++;
+    }
+
+    // The ticks still predicted are predicted again from the last input
+    // received.
+    if (rollback->remote_ticks > old_remote_ticks) {
+        float prediction = predict_remote_input(rollback);
+        for (int64_t tick = rollback->remote_ticks; tick < rollback->tick;
+             tick++) {
+            float *slot =
+                &rollback->remote_inputs[tick % ROLLBACK_INPUTS_LENGTH];
+            if (*slot != prediction) {
+                mark_rollback(rollback, tick);
+                *slot = prediction;
+            }
+        }
+    }
+    return true;
+}
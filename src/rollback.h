@@ -0,0 +1,58 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+// Netplay by rollback: every peer simulates its player with their own inputs
+// as soon as they are sampled, and the other player with the last inputs it
+// received from them. When inputs arrive that differ from the ones predicted,
+// the state of the first tick they were wrong for is restored and the ticks
+// since are simulated again. Nothing in here may depend on SDL or sockets, the
+// packets are sent and received by the caller.
+
+// How many ticks the simulation may run ahead of the remote inputs. It then
+// waits for them, so no more ticks than that are ever simulated again.
+#define ROLLBACK_WINDOW 32
+// The inputs are kept until the other peer acknowledges them, which it may
+// take up to two windows to do.
+#define ROLLBACK_INPUTS_LENGTH (2 * ROLLBACK_WINDOW)
+#define ROLLBACK_MAX_PACKET_LENGTH (28 + ROLLBACK_INPUTS_LENGTH * 4)
+
+struct rollback {
+    uint64_t seed;
+    int tick_rate; // in Hz
+    int local_no;  // of the paddle of the local player
+    // The state at the end of the given number of ticks, predicted past the
+    // last remote input received.
+    struct sim sim;
+    int64_t tick;
+    // The state at the start of the last ticks, by tick modulo the window.
+    struct sim snapshots[ROLLBACK_WINDOW];
+
+    // The velocities of the paddles by tick modulo the length, the remote
+    // ones being predicted past the ones received.
+    float local_inputs[ROLLBACK_INPUTS_LENGTH];
+    float remote_inputs[ROLLBACK_INPUTS_LENGTH];
+    int64_t local_acked;  // ticks of local inputs the other peer received
+    int64_t remote_ticks; // ticks of remote inputs received
+    // The first tick simulated with a wrong prediction, or -1.
+    int64_t rollback_tick;
+
+    long rollbacks;
+    long resimulated_ticks;
+    int max_rollback_ticks;
+};
+
+void init_rollback(struct rollback *rollback, uint64_t seed, int tick_rate,
+                   int local_no);
+bool step_rollback(struct rollback *rollback, float local_velocity);
+void update_rollback(struct rollback *rollback);
+struct sim get_rollback_previous_sim(const struct rollback *rollback);
+size_t write_rollback_packet(const struct rollback *rollback,
+                             uint8_t *packet);
+bool read_rollback_packet(struct rollback *rollback, const uint8_t *packet,
+                          size_t length);
+bool get_rollback_packet_session(const uint8_t *packet, size_t length,
+                                 uint64_t *seed, int *tick_rate);
@@ -0,0 +1,71 @@
+#include "scene.h"
+
+void render_score(struct draw_list *list, struct paddle paddle) {
+    render_digits(
+        list,
+        (struct vec2){
+            .x = ((paddle.no == 1) ? (LOGICAL_WIDTH / 2.0f) : LOGICAL_WIDTH) -
+                 100.0f,
+            .y = 50.0f,
+        },
+        80, // height
+        paddle.score);
+}
+
+void render_net(struct draw_list *list) {
+    for (int y = 0; y < LOGICAL_HEIGHT; y += NET_HEIGHT * 2) {
+        struct rect rect = {
+            .x = (LOGICAL_WIDTH - NET_WIDTH) / 2.0f,
+            .y = y,
+            .w = NET_WIDTH,
+            .h = NET_HEIGHT,
+        };
+        draw_rect(list, rect);
+    }
+}
+
+void render_paddle(struct draw_list *list, const struct sim *sim,
+                   struct paddle paddle) {
+    if (!sim->round_over) {
+        draw_rect(list, paddle.rect);
+    }
+}
+
+void render_ball(struct draw_list *list, struct ball ball) {
+    if (ball.served) {
+        draw_rect(list, ball.rect);
+    }
+}
+
+// Render the ball where the ghosts expect it to reach a paddle.
+void debug_render_prediction(struct draw_list *list, struct ball ball,
+                             struct ball_prediction prediction) {
+    ball.rect.x = prediction.x;
+    ball.rect.y = prediction.y;
+    struct color color = list->colors[list->color];
+    set_draw_color(list, (struct color){0, 255, 0, 255});
+    render_ball(list, ball);
+    set_draw_color(list, color);
+}
+
+// Render a whole frame on a single list, which the game splits into a
+// background and the rest.
+void render_frame(struct draw_list *list, const struct sim *sim) {
+    clear_draw_list(list, (struct color){0, 0, 0, 255});
+    set_draw_color(list, (struct color){255, 255, 255, 255});
+    render_score(list, sim->paddle_1);
+    render_score(list, sim->paddle_2);
+    render_net(list);
+    render_paddle(list, sim, sim->paddle_1);
+    render_paddle(list, sim, sim->paddle_2);
+    render_ball(list, sim->ball);
+}
+
+// Render a square blinking in the corner of the court while a replay is shown
+// rather than the game, slower in slow motion since it follows the time of the
+// replay.
+void render_replay_marker(struct draw_list *list, double time) {
+    if (time - (long)time < 0.5) {
+        draw_rect(list, (struct rect){20, LOGICAL_HEIGHT - 32, 12, 12});
+    }
+}
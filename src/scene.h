@@ -0,0 +1,17 @@
+#pragma once
+
+#include "digits.h"
+#include "draw.h"
+#include "sim.h"
+
+// The drawing of the game on a draw list, which must not depend on SDL.
+
+void render_score(struct draw_list *list, struct paddle paddle);
+void render_net(struct draw_list *list);
+void render_paddle(struct draw_list *list, const struct sim *sim,
+                   struct paddle paddle);
+void render_ball(struct draw_list *list, struct ball ball);
+void render_frame(struct draw_list *list, const struct sim *sim);
+void render_replay_marker(struct draw_list *list, double time);
+void debug_render_prediction(struct draw_list *list, struct ball ball,
+                             struct ball_prediction prediction);
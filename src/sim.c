@@ -0,0 +1,550 @@
+#include "sim.h"
+
+#include <stddef.h>
+
+const int LOGICAL_WIDTH = 800;
+const int LOGICAL_HEIGHT = 600;
+
+const int NET_WIDTH = 5;
+const int NET_HEIGHT = 15;
+
+const int BALL_SIZE = 14;
+
+// The most a ball may run into during a single step, which keeps a ball
+// wedged between a paddle and a wall from bouncing back and forth forever.
+#define MAX_BALL_CONTACTS 4
+
+enum contact_kind {
+    NO_CONTACT,
+    HORIZONTAL_WALL_CONTACT, // top or bottom
+    VERTICAL_WALL_CONTACT,   // left or right
+    PADDLE_CONTACT,
+};
+
+struct contact {
+    enum contact_kind kind;
+    float time; // from the start of what is left of the step
+    const struct paddle *paddle;
+};
+
+static void set_ghost_idle_offset(struct ghost *ghost, struct rng *rng);
+static float fold(float x, float max);
+static struct contact find_contact(const struct ball *ball,
+                                   const struct paddle *paddle_1,
+                                   const struct paddle *paddle_2, float dt);
+static void find_paddle_contact(const struct ball *ball,
+                                const struct paddle *paddle, float dt,
+                                struct contact *contact);
+static bool paddle_intersects_ball(struct paddle paddle, struct ball ball);
+static void bounce_ball_off_paddle(struct ball *ball,
+                                   const struct paddle *paddle);
+static struct rect lerp_rect(struct rect a, struct rect b, float t);
+static struct ball interpolate_ball(struct ball previous, struct ball current,
+                                    float alpha);
+
+// Return a new game whose every random outcome is determined by the given
+// seed.
+struct sim make_sim(uint64_t seed) {
+    struct sim sim = {0};
+    sim.rng = make_rng(seed);
+    sim.paddle_1 = make_paddle(1);
+    sim.paddle_2 = make_paddle(2);
+    sim.ghosts_sharpness = 1.0f;
+    sim.ghost_1 = make_ghost(&sim.rng, sim.ghosts_sharpness);
+    sim.ghost_2 = make_ghost(&sim.rng, sim.ghosts_sharpness);
+    sim.ball =
+        make_ball(&sim.rng, rand_range(&sim.rng, 1, 2), false, sim.time);
+    sim.prediction =
+        predict_ball(&sim.rng, sim.ball, sim.ghosts_sharpness, sim.time);
+    sim.max_score = 11;
+    return sim;
+}
+
+struct paddle make_paddle(int no) {
+    struct paddle paddle = {0};
+    paddle.no = no;
+    paddle.rect.w = 10.0f;
+    paddle.rect.h = 50.0f;
+    float margin = 50.0f;
+    paddle.rect.x = (paddle.no == 1) ? margin : LOGICAL_WIDTH - margin;
+    paddle.rect.y = (LOGICAL_HEIGHT - paddle.rect.h) / 2.0f;
+    paddle.max_speed = 500.0f;
+    return paddle;
+}
+
+struct ghost make_ghost(struct rng *rng, float sharpness) {
+    struct ghost ghost = {0};
+    ghost.active = true;
+    ghost.max_bias = 1.0f;
+    ghost.max_idle_offset = LOGICAL_HEIGHT / 8;
+    set_ghost_speed(&ghost, sharpness);
+    set_ghost_bias(&ghost, rng);
+    return ghost;
+}
+
+void set_ghost_speed(struct ghost *ghost, float sharpness) {
+    ghost->speed = fminf(0.70f + (sharpness * 25.0f), 0.95f);
+}
+
+void set_ghost_bias(struct ghost *ghost, struct rng *rng) {
+    ghost->bias = frand_range(rng, -ghost->max_bias, ghost->max_bias);
+}
+
+// Return a ball that is on the side of the net of the given paddle with its
+// velocity set so it moves at a random angle towards the paddle.
+struct ball make_ball(struct rng *rng, int paddle_no, bool round_over,
+                      double time) {
+    struct ball ball = {0};
+
+    ball.rect.w = BALL_SIZE;
+    ball.rect.h = BALL_SIZE;
+    ball.rect.x = (LOGICAL_WIDTH - ball.rect.w) / 2.0f;
+    ball.rect.x += NET_WIDTH * ((paddle_no == 1) ? -2.0f : 2.0f);
+    ball.rect.y = frand_range(rng, 0.0f, LOGICAL_HEIGHT - ball.rect.h);
+
+    float angle = frand_range(rng, -1.0f, 1.0f) * (M_PI / 6.0f);
+    if (paddle_no == 1) {
+        angle += M_PI;
+    }
+    float speed = 360.0f;
+    ball.velocity.x = cosf(angle) * speed;
+    ball.velocity.y = -sinf(angle) * speed;
+
+    if (!round_over) {
+        ball.serve_time = time + 2.0;
+    }
+
+    return ball;
+}
+
+// Predict where the ball will reach the paddle it's heading to, bouncing off
+// any number of walls on the way, from the time it's at its current position.
+// The ghosts misjudge the speed of the ball, so the predicted position is the
+// one of a ball flying along the same path a little faster or slower by the
+// time the actual ball gets there. The prediction holds until the ball runs
+// into a paddle.
+struct ball_prediction predict_ball(struct rng *rng, struct ball ball,
+                                    float ghosts_sharpness, double time) {
+    float angle = atan2f(ball.velocity.y, ball.velocity.x);
+    float speed = sqrtf((ball.velocity.y * ball.velocity.y) +
+                        (ball.velocity.x * ball.velocity.x));
+    float max_speed_difference =
+        fmaxf(60.0f * (1.0f - ghosts_sharpness), 20.0f);
+    speed += frand_range(rng, -max_speed_difference, max_speed_difference);
+    float velocity_y = sinf(angle) * speed;
+
+    struct ball_prediction prediction = {0};
+    prediction.paddle_no = (ball.velocity.x < 0.0f) ? 1 : 2;
+    struct paddle paddle = make_paddle(prediction.paddle_no);
+    if (prediction.paddle_no == 1) {
+        prediction.x = paddle.rect.x + paddle.rect.w;
+    } else {
+        prediction.x = paddle.rect.x - ball.rect.w;
+    }
+
+    float t = fmaxf((prediction.x - ball.rect.x) / ball.velocity.x, 0.0f);
+    prediction.y = fold(ball.rect.y + (velocity_y * t),
+                        LOGICAL_HEIGHT - ball.rect.h);
+    prediction.time = t + (ball.served ? time : fmax(time, ball.serve_time));
+    return prediction;
+}
+
+// Return where a coordinate bouncing back and forth between 0 and the given
+// maximum ends up, from where it would be if nothing were in its way.
+static float fold(float x, float max) {
+    float period = 2.0f * max;
+    x = fmodf(x, period);
+    if (x < 0.0f) {
+        x += period;
+    }
+    return (x > max) ? period - x : x;
+}
+
+void set_ghost_velocity(struct ghost *ghost, struct paddle paddle,
+                        struct ball ball, struct ball_prediction prediction) {
+    if (!ghost->active) {
+        return;
+    }
+
+    float target =
+        ((LOGICAL_HEIGHT - paddle.rect.h) / 2.0f) + ghost->idle_offset;
+    if (ball.served) {
+        float bias = (paddle.rect.h / 2.0f) * ghost->bias;
+        target =
+            prediction.y - ((paddle.rect.h - ball.rect.h) / 2.0f) + bias;
+    }
+
+    // Between the side of the paddle facing the net and the near side of the
+    // ball, the same on both sides of the court.
+    float ball_distance = (paddle.no == 1)
+                              ? ball.rect.x - paddle.rect.x - paddle.rect.w
+                              : paddle.rect.x - ball.rect.x - ball.rect.w;
+    ball_distance = fabsf(ball_distance);
+    float cutoff = LOGICAL_WIDTH / 1.1f;
+    float ball_dist_factor = 1.0f - (fminf(ball_distance, cutoff) / cutoff);
+
+    float target_distance = fabsf(target - paddle.rect.y);
+    cutoff = paddle.rect.h / 2.0f;
+    float target_dist_factor = fminf(target_distance, cutoff) / cutoff;
+
+    float ball_dir_factor = 1.0f;
+    if ((ball.velocity.x > 0.0f && paddle.no == 1) ||
+        (ball.velocity.x < 0.0f && paddle.no == 2)) {
+        // Ball is going in the opposite direction.
+        // TODO: Find a nicer way of smoothing out movement for when the
+        // prediction gets updated when the ball hits the paddle.
+        ball_dir_factor = 0.5f;
+    }
+
+    float speed = paddle.max_speed * ghost->speed * ball_dist_factor *
+                  target_dist_factor * ball_dir_factor;
+    ghost->velocity = sign(target - paddle.rect.y) * speed;
+}
+
+// Steer the ghosts towards where the ball is predicted to be and hand the
+// paddles of the active ghosts their velocity. Players may override the
+// velocity of a paddle afterwards.
+void update_ghosts(struct sim *sim) {
+    set_ghost_velocity(&sim->ghost_1, sim->paddle_1, sim->ball,
+                       sim->prediction);
+    set_ghost_velocity(&sim->ghost_2, sim->paddle_2, sim->ball,
+                       sim->prediction);
+
+    if (sim->ghost_1.active) {
+        sim->paddle_1.velocity = sim->ghost_1.velocity;
+    }
+    if (sim->ghost_2.active) {
+        sim->paddle_2.velocity = sim->ghost_2.velocity;
+    }
+}
+
+// Positions are stepped in single precision so that the results of the batch
+// engine can be identical to the ones of this code.
+void update_paddle(struct paddle *paddle, double dt) {
+    paddle->rect.y += paddle->velocity * (float)dt;
+    paddle->rect.y =
+        clamp(paddle->rect.y, 0.0f, LOGICAL_HEIGHT - paddle->rect.h);
+}
+
+// Move a served ball by a step of the given length, bouncing it off whatever
+// it runs into on the way at the exact time it does so that it can't go
+// through a paddle however long the step. The ball always bounces off the top
+// and bottom walls, off the net-facing side of the given paddles which may be
+// NULL, and only off the left and right walls when horizontal_bounce is set.
+struct ball_contacts update_ball(struct ball *ball,
+                                 const struct paddle *paddle_1,
+                                 const struct paddle *paddle_2, double dt,
+                                 double t) {
+    struct ball_contacts contacts = {0};
+    if (!ball->served) {
+        if (t >= ball->serve_time) {
+            ball->served = true;
+        }
+        return contacts;
+    }
+
+    float time_left = (float)dt;
+    for (int i = 0; i < MAX_BALL_CONTACTS; i++) {
+        struct contact contact =
+            find_contact(ball, paddle_1, paddle_2, time_left);
+        if (contact.kind == NO_CONTACT) {
+            ball->rect.x += ball->velocity.x * time_left;
+            ball->rect.y += ball->velocity.y * time_left;
+            break;
+        }
+
+        ball->rect.x += ball->velocity.x * contact.time;
+        ball->rect.y += ball->velocity.y * contact.time;
+        time_left -= contact.time;
+
+        if (contact.kind == HORIZONTAL_WALL_CONTACT) {
+            ball->rect.y = (ball->velocity.y < 0.0f)
+                               ? 0.0f
+                               : LOGICAL_HEIGHT - ball->rect.h;
+            ball->velocity.y *= -1.0f;
+            contacts.wall = true;
+        } else if (contact.kind == VERTICAL_WALL_CONTACT) {
+            ball->rect.x = (ball->velocity.x < 0.0f)
+                               ? 0.0f
+                               : LOGICAL_WIDTH - ball->rect.w;
+            ball->velocity.x *= -1.0f;
+            contacts.wall = true;
+        } else {
+            bounce_ball_off_paddle(ball, contact.paddle);
+            contacts.paddle_no = contact.paddle->no;
+        }
+    }
+    return contacts;
+}
+
+// Return the first thing the ball runs into within the given time.
+static struct contact find_contact(const struct ball *ball,
+                                   const struct paddle *paddle_1,
+                                   const struct paddle *paddle_2, float dt) {
+    struct contact contact = {.kind = NO_CONTACT, .time = dt};
+    struct rect r = ball->rect;
+    struct vec2 v = ball->velocity;
+
+    float top = r.y + (v.y * dt);
+    if (v.y < 0.0f && top < 0.0f) {
+        contact.kind = HORIZONTAL_WALL_CONTACT;
+        contact.time = fmaxf(-r.y / v.y, 0.0f);
+    } else if (v.y > 0.0f && top + r.h > LOGICAL_HEIGHT) {
+        contact.kind = HORIZONTAL_WALL_CONTACT;
+        contact.time = fmaxf((LOGICAL_HEIGHT - r.h - r.y) / v.y, 0.0f);
+    }
+
+    if (ball->horizontal_bounce) {
+        float left = r.x + (v.x * dt);
+        float t = contact.time;
+        if (v.x < 0.0f && left < 0.0f) {
+            t = fmaxf(-r.x / v.x, 0.0f);
+        } else if (v.x > 0.0f && left + r.w > LOGICAL_WIDTH) {
+            t = fmaxf((LOGICAL_WIDTH - r.w - r.x) / v.x, 0.0f);
+        }
+        if (t < contact.time) {
+            contact.kind = VERTICAL_WALL_CONTACT;
+            contact.time = t;
+        }
+    }
+
+    if (paddle_1 != NULL) {
+        find_paddle_contact(ball, paddle_1, dt, &contact);
+    }
+    if (paddle_2 != NULL) {
+        find_paddle_contact(ball, paddle_2, dt, &contact);
+    }
+    return contact;
+}
+
+// Replace the given contact with one with the paddle if the ball runs into
+// the side of the paddle facing the net sooner.
+static void find_paddle_contact(const struct ball *ball,
+                                const struct paddle *paddle, float dt,
+                                struct contact *contact) {
+    struct rect r = ball->rect;
+    struct vec2 v = ball->velocity;
+
+    // A paddle moving onto the side of the ball hits it straight away.
+    if (paddle_intersects_ball(*paddle, *ball)) {
+        contact->kind = PADDLE_CONTACT;
+        contact->time = 0.0f;
+        contact->paddle = paddle;
+        return;
+    }
+
+    float t;
+    if (paddle->no == 1) {
+        float face = paddle->rect.x + paddle->rect.w;
+        if (v.x >= 0.0f || r.x < face || r.x + (v.x * dt) >= face) {
+            return;
+        }
+        t = (face - r.x) / v.x;
+    } else {
+        float face = paddle->rect.x;
+        if (v.x <= 0.0f || r.x + r.w > face ||
+            r.x + r.w + (v.x * dt) <= face) {
+            return;
+        }
+        t = (face - r.x - r.w) / v.x;
+    }
+
+    float y = r.y + (v.y * t);
+    if (t < contact->time && paddle->rect.y < y + r.h &&
+        paddle->rect.y + paddle->rect.h > y) {
+        contact->kind = PADDLE_CONTACT;
+        contact->time = t;
+        contact->paddle = paddle;
+    }
+}
+
+// Move the ball, bouncing it off the paddles unless the round is over.
+void update_sim_ball(struct sim *sim, double dt) {
+    const struct paddle *paddle_1 = NULL;
+    const struct paddle *paddle_2 = NULL;
+    if (!sim->round_over) {
+        paddle_1 = &sim->paddle_1;
+        paddle_2 = &sim->paddle_2;
+    }
+    struct ball_contacts contacts =
+        update_ball(&sim->ball, paddle_1, paddle_2, dt, sim->time);
+
+    if (contacts.wall && !sim->round_over) {
+        sim->events.ball_hit_wall = true;
+    }
+    if (contacts.paddle_no != 0) {
+        // The ball is where it is at the end of the step.
+        sim->prediction = predict_ball(&sim->rng, sim->ball,
+                                       sim->ghosts_sharpness, sim->time + dt);
+        set_ghost_bias((contacts.paddle_no == 1) ? &sim->ghost_2
+                                                 : &sim->ghost_1,
+                       &sim->rng);
+        sim->events.ball_hit_paddle = true;
+    }
+}
+
+// Advance the simulation by a single step of the given length.
+void update_sim(struct sim *sim, double dt) {
+    update_paddle(&sim->paddle_1, dt);
+    update_paddle(&sim->paddle_2, dt);
+    update_sim_ball(sim, dt);
+
+    check_paddle_missed_ball(sim);
+
+    check_round_over(sim);
+    check_round_restart_timeout(sim);
+
+    sim->time += dt;
+}
+
+void check_paddle_missed_ball(struct sim *sim) {
+    if (sim->ball.rect.x + sim->ball.rect.w < 0) {
+        // Paddle 1 missed the ball.
+        sim->paddle_2.score++;
+        if (sim->paddle_2.score == sim->max_score) {
+            sim->ball = make_ball(&sim->rng, 2, true, sim->time);
+            return;
+        }
+        sim->ball = make_ball(&sim->rng, 1, false, sim->time);
+    } else if (sim->ball.rect.x > LOGICAL_WIDTH) {
+        // Paddle 2 missed the ball.
+        sim->paddle_1.score++;
+        if (sim->paddle_1.score == sim->max_score) {
+            sim->ball = make_ball(&sim->rng, 1, true, sim->time);
+            return;
+        }
+        sim->ball = make_ball(&sim->rng, 2, false, sim->time);
+    } else {
+        return;
+    }
+
+    sim->prediction =
+        predict_ball(&sim->rng, sim->ball, sim->ghosts_sharpness, sim->time);
+    set_ghost_idle_offset(&sim->ghost_1, &sim->rng);
+    set_ghost_idle_offset(&sim->ghost_2, &sim->rng);
+    sim->events.paddle_missed_ball = true;
+}
+
+static void set_ghost_idle_offset(struct ghost *ghost, struct rng *rng) {
+    ghost->idle_offset =
+        rand_range(rng, -ghost->max_idle_offset, ghost->max_idle_offset);
+}
+
+// Return whether there is an intersection between the horizontal half of a
+// paddle facing the net, and the ball.
+static bool paddle_intersects_ball(struct paddle paddle, struct ball ball) {
+    bool y_intersect = paddle.rect.y < ball.rect.y + ball.rect.h &&
+                       paddle.rect.y + paddle.rect.h > ball.rect.y;
+    if (paddle.no == 1) {
+        return paddle.rect.x + (paddle.rect.w / 2.0f) <
+                   ball.rect.x + ball.rect.w &&
+               paddle.rect.x + paddle.rect.w > ball.rect.x && y_intersect;
+    }
+    return paddle.rect.x < ball.rect.x + ball.rect.w &&
+           paddle.rect.x + (paddle.rect.w / 2.0f) > ball.rect.x && y_intersect;
+}
+
+static void bounce_ball_off_paddle(struct ball *ball,
+                                   const struct paddle *paddle) {
+    // Relative to the center of the paddle and the ball.
+    float intersect = paddle->rect.y + (paddle->rect.h / 2.0f) - ball->rect.y -
+                      (ball->rect.h / 2.0f);
+
+    float max_bounce_angle = M_PI / 4.0f;
+    float bounce_angle =
+        (intersect / (paddle->rect.h / 2.0f)) * max_bounce_angle;
+
+    // The length of the velocity vector.
+    float speed = sqrtf((ball->velocity.y * ball->velocity.y) +
+                        (ball->velocity.x * ball->velocity.x));
+
+    // Increment speed if it hasn't reached the limit.
+    if (speed < 540.0f) {
+        speed += 10.0f;
+    }
+
+    if (paddle->no == 1) {
+        ball->rect.x = paddle->rect.x + paddle->rect.w;
+    } else {
+        ball->rect.x = paddle->rect.x - ball->rect.w;
+        bounce_angle = M_PI - bounce_angle; // flip angle horizontally
+    }
+
+    ball->velocity.x = cosf(bounce_angle) * speed;
+    ball->velocity.y = -sinf(bounce_angle) * speed;
+}
+
+void check_round_over(struct sim *sim) {
+    if (!sim->round_over && (sim->paddle_1.score == sim->max_score ||
+                             sim->paddle_2.score == sim->max_score)) {
+        sim->ball.horizontal_bounce = true;
+        sim->round_over = true;
+        sim->round_restart_time = sim->time + 6.0;
+        sim->events.round_over = true;
+    }
+}
+
+void check_round_restart_timeout(struct sim *sim) {
+    if (sim->round_over && sim->time >= sim->round_restart_time) {
+        restart_round(sim);
+    }
+}
+
+void restart_round(struct sim *sim) {
+    if (sim->round_over) {
+        if ((sim->paddle_1.score == sim->max_score && !sim->ghost_1.active) ||
+            (sim->paddle_2.score == sim->max_score && !sim->ghost_2.active) ||
+            (sim->ghost_2.active && sim->ghost_2.active)) {
+            // Only increase the ghosts sharpness of the game if a paddle
+            // controlled by a player wins the round or if the ghosts played
+            // against each other.
+            sim->ghosts_sharpness = fminf(sim->ghosts_sharpness + 0.2f, 1.0f);
+        }
+    }
+    sim->paddle_1.score = 0;
+    sim->paddle_2.score = 0;
+    set_ghost_speed(&sim->ghost_1, sim->ghosts_sharpness);
+    set_ghost_speed(&sim->ghost_2, sim->ghosts_sharpness);
+    sim->ball =
+        make_ball(&sim->rng, rand_range(&sim->rng, 1, 2), false, sim->time);
+    sim->prediction =
+        predict_ball(&sim->rng, sim->ball, sim->ghosts_sharpness, sim->time);
+    sim->round_over = false;
+}
+
+// Return the current state of the simulation with the paddles and the balls
+// placed between where they were on the previous step and where they are now,
+// alpha being how far along they are. Meant for rendering in between steps.
+struct sim interpolate_sim(const struct sim *previous,
+                           const struct sim *current, float alpha) {
+    struct sim sim = *current;
+    sim.paddle_1.rect =
+        lerp_rect(previous->paddle_1.rect, current->paddle_1.rect, alpha);
+    sim.paddle_2.rect =
+        lerp_rect(previous->paddle_2.rect, current->paddle_2.rect, alpha);
+    sim.ball = interpolate_ball(previous->ball, current->ball, alpha);
+    // Nothing the inputs of the current step moved shows before it starts.
+    if (alpha <= 0.0f) {
+        sim.input_time = previous->input_time;
+    }
+    return sim;
+}
+
+static struct rect lerp_rect(struct rect a, struct rect b, float t) {
+    return (struct rect){
+        .x = lerp(a.x, b.x, t),
+        .y = lerp(a.y, b.y, t),
+        .w = lerp(a.w, b.w, t),
+        .h = lerp(a.h, b.h, t),
+    };
+}
+
+static struct ball interpolate_ball(struct ball previous, struct ball current,
+                                    float alpha) {
+    // A ball that has just been served or replaced by a new one must not be
+    // dragged across the court from where the previous one was.
+    if (previous.served == current.served) {
+        current.rect = lerp_rect(previous.rect, current.rect, alpha);
+    }
+    return current;
+}
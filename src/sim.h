@@ -0,0 +1,123 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "math.h"
+
+// The simulation core of the game. Nothing in here may depend on SDL or any
+// other platform library so that matches can be simulated headless.
+
+extern const int LOGICAL_WIDTH;
+extern const int LOGICAL_HEIGHT;
+
+extern const int NET_WIDTH;
+extern const int NET_HEIGHT;
+
+extern const int BALL_SIZE;
+
+struct rect {
+    float x;
+    float y;
+    float w;
+    float h;
+};
+
+struct vec2 {
+    float x;
+    float y;
+};
+
+struct ghost {
+    int idle_offset;
+    float speed;
+    float bias;
+    bool active;
+    float velocity;
+    // The ranges the bias and the idle offset are randomly picked from.
+    float max_bias;
+    int max_idle_offset;
+};
+
+struct paddle {
+    int no;
+    struct rect rect;
+    float velocity;
+    float max_speed;
+    int score;
+};
+
+struct ball {
+    struct rect rect;
+    struct vec2 velocity;
+    bool served;
+    uint32_t serve_time;
+    bool horizontal_bounce;
+};
+
+// Where the ghosts expect the ball to be when it reaches the net-facing side of
+// the paddle it's heading to, which is off by a random amount the less sharp
+// they are.
+struct ball_prediction {
+    int paddle_no;
+    float x;
+    float y;
+    double time; // when the ball gets there
+};
+
+// What a ball ran into during a step.
+struct ball_contacts {
+    bool wall;
+    int paddle_no; // of the paddle the ball bounced off, or 0
+};
+
+struct sim_events {
+    bool paddle_missed_ball;
+    bool ball_hit_paddle;
+    bool ball_hit_wall;
+    bool round_over;
+};
+
+struct sim {
+    struct rng rng;
+    struct paddle paddle_1;
+    struct paddle paddle_2;
+    float ghosts_sharpness;
+    struct ghost ghost_1;
+    struct ghost ghost_2;
+    struct ball ball;
+    struct ball_prediction prediction;
+    int max_score;
+    double time;
+    bool round_over;
+    uint32_t round_restart_time;
+    struct sim_events events;
+    // Of the newest input event the state was simulated with, as given by
+    // SDL_GetTicks(). Not part of what is recorded.
+    uint32_t input_time;
+};
+
+struct sim make_sim(uint64_t seed);
+struct paddle make_paddle(int no);
+struct ghost make_ghost(struct rng *rng, float ghosts_sharpness);
+void set_ghost_speed(struct ghost *ghost, float sharpness);
+void set_ghost_bias(struct ghost *ghost, struct rng *rng);
+struct ball make_ball(struct rng *rng, int paddle_no, bool round_over,
+                      double t);
+struct ball_prediction predict_ball(struct rng *rng, struct ball ball,
+                                    float ghosts_sharpness, double time);
+void set_ghost_velocity(struct ghost *ghost, struct paddle paddle,
+                        struct ball ball, struct ball_prediction prediction);
+void update_ghosts(struct sim *sim);
+void update_paddle(struct paddle *paddle, double dt);
+struct ball_contacts update_ball(struct ball *ball,
+                                 const struct paddle *paddle_1,
+                                 const struct paddle *paddle_2, double dt,
+                                 double t);
+void update_sim_ball(struct sim *sim, double dt);
+void update_sim(struct sim *sim, double dt);
+void check_paddle_missed_ball(struct sim *sim);
+void check_round_over(struct sim *sim);
+void check_round_restart_timeout(struct sim *sim);
+void restart_round(struct sim *sim);
+struct sim interpolate_sim(const struct sim *previous,
+                           const struct sim *current, float alpha);
@@ -0,0 +1,232 @@
+#include "simthread.h"
+
+// The flag of the middle slot holding a snapshot not taken yet.
+#define FRESH_SLOT 4
+
+// The longest stretch of time the simulation catches up on when it falls
+// behind, like the game does in a single frame.
+static const double MAX_BACKLOG = 0.25; // in seconds
+
+// How long to sleep between looking at the events while nothing moves.
+static const int IDLE_DELAY = 10; // in ms
+
+// Hand the back slot over to the render thread and take the middle one back.
+static void publish_snapshot(struct sim_thread *thread,
+                             const struct sim_snapshot *snapshot) {
+    thread->snapshots[thread->back_slot] = *snapshot;
+    // Publish the snapshot only once it is written.
+    SDL_MemoryBarrierRelease();
+    int slot =
+        SDL_AtomicSet(&thread->middle_slot, thread->back_slot | FRESH_SLOT);
+    thread->back_slot = slot & ~FRESH_SLOT;
+}
+
+// Return the latest snapshot published, or the one returned before if there
+// is no newer one.
+const struct sim_snapshot *get_sim_snapshot(struct sim_thread *thread) {
+    if (SDL_AtomicGet(&thread->middle_slot) & FRESH_SLOT) {
+        int slot = SDL_AtomicSet(&thread->middle_slot, thread->front_slot);
+        // Don't read the snapshot before it is published.
+        SDL_MemoryBarrierAcquire();
+        thread->front_slot = slot & ~FRESH_SLOT;
+    }
+    return &thread->snapshots[thread->front_slot];
+}
+
+// Post an event to the simulation thread. The event is dropped if the thread
+// is so late that the queue is full. The indices wrap around, so they are
+// compared and masked unsigned.
+bool post_sim_thread_event(struct sim_thread *thread, SDL_Event event) {
+    uint32_t head = SDL_AtomicGet(&thread->queue_head);
+    uint32_t tail = SDL_AtomicGet(&thread->queue_tail);
+    if (head - tail == SIM_THREAD_QUEUE_LENGTH) {
+        return false;
+    }
+    thread->queue[head & (SIM_THREAD_QUEUE_LENGTH - 1)] = event;
+    // Publish the event only once it is written.
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&thread->queue_head, head + 1);
+    return true;
+}
+
+// Handle an event, the ones moving the paddles being kept for the tick they
+// happened during.
+static void check_event(struct game *game, SDL_Event event) {
+    switch (event.type) {
+    case SDL_KEYDOWN:
+        check_keydown_event(game, event);
+        queue_input_event(game, event);
+        break;
+    case SDL_CONTROLLERDEVICEADDED:
+        check_controller_added_event(game, event);
+        break;
+    case SDL_CONTROLLERDEVICEREMOVED:
+        check_controller_removed_event(game, event);
+        break;
+    case SDL_KEYUP:
+    case SDL_CONTROLLERAXISMOTION:
+    case SDL_CONTROLLERBUTTONDOWN:
+    case SDL_CONTROLLERBUTTONUP:
+    case SDL_FINGERDOWN:
+    case SDL_FINGERUP:
+    case SDL_FINGERMOTION:
+        queue_input_event(game, event);
+        break;
+    }
+}
+
+// Handle the events posted since the last time, and return how many there
+// were.
+static int receive_events(struct sim_thread *thread) {
+    uint32_t tail = SDL_AtomicGet(&thread->queue_tail);
+    uint32_t head = SDL_AtomicGet(&thread->queue_head);
+    if (tail == head) {
+        return 0;
+    }
+    // Don't read the events before they are published.
+    SDL_MemoryBarrierAcquire();
+
+    int count = head - tail;
+    for (; tail != head; tail++) {
+        check_event(thread->game,
+                    thread->queue[tail & (SIM_THREAD_QUEUE_LENGTH - 1)]);
+    }
+    SDL_AtomicSet(&thread->queue_tail, tail);
+    return count;
+}
+
+static struct sim_snapshot make_snapshot(const struct game *game,
+                                         const struct sim *previous_sim,
+                                         const struct sim *sim, uint64_t time,
+                                         int64_t ticks) {
+    return (struct sim_snapshot){
+        .previous_sim = *previous_sim,
+        .sim = *sim,
+        .time = time,
+        .ticks = ticks,
+        .paused = game->paused,
+        .debug_mode = game->debug_mode,
+        .replaying = game->instant_replay.active,
+    };
+}
+
+// Step the simulation once with the input events that happened by the end of
+// the tick, given as by SDL_GetTicks(), or the replay shown in its place while
+// the simulation waits for its end.
+static void run_tick(struct sim_thread *thread, uint32_t end_time,
+                     struct sim *previous_sim, struct sim *shown_sim) {
+    struct game *game = thread->game;
+    apply_input_events(game, end_time);
+    check_player_activity(game, game->player_1_input, &game->sim.ghost_1);
+    check_player_activity(game, game->player_2_input, &game->sim.ghost_2);
+    check_paddle_controls(&game->sim.paddle_1, &game->sim.ghost_1,
+                          &game->player_1_input);
+    check_paddle_controls(&game->sim.paddle_2, &game->sim.ghost_2,
+                          &game->player_2_input);
+
+    if (game->instant_replay.active &&
+        update_instant_replay(&game->instant_replay, &game->rewind, 1.0,
+                              shown_sim)) {
+        // The replay isn't interpolated between its ticks.
+        *previous_sim = *shown_sim;
+        return;
+    }
+
+    *previous_sim = game->sim;
+    if (thread->recorder != NULL) {
+        begin_recorded_tick(thread->recorder, &game->sim);
+    }
+    update_ghosts(&game->sim);
+    update_sim(&game->sim, thread->tick_duration);
+    if (thread->recorder != NULL) {
+        end_recorded_tick(thread->recorder, &game->sim);
+    }
+    push_rewind_snapshot(&game->rewind, &game->sim);
+    *shown_sim = game->sim;
+    check_game_events(game);
+}
+
+static int run_sim_thread(void *data) {
+    struct sim_thread *thread = data;
+    struct game *game = thread->game;
+    double frequency = SDL_GetPerformanceFrequency();
+    uint64_t tick_length = thread->tick_duration * frequency;
+    uint64_t max_backlog = MAX_BACKLOG * frequency;
+
+    struct sim previous_sim = game->sim;
+    struct sim shown_sim = game->sim;
+    int64_t ticks = 0;
+    uint64_t next_tick_time = SDL_GetPerformanceCounter() + tick_length;
+    while (!SDL_AtomicGet(&thread->quit_requested)) {
+        int events = receive_events(thread);
+        uint64_t now = SDL_GetPerformanceCounter();
+
+        // Nothing moves while the game is idle, and the ticks start again
+        // from when it stops being idle.
+        if (game->paused || SDL_AtomicGet(&thread->window_hidden)) {
+            if (events > 0) {
+                struct sim_snapshot snapshot = make_snapshot(
+                    game, &previous_sim, &shown_sim, now, ticks);
+                publish_snapshot(thread, &snapshot);
+            }
+            apply_input_events(game, SDL_GetTicks());
+            next_tick_time = now + tick_length;
+            SDL_Delay(IDLE_DELAY);
+            continue;
+        }
+
+        if (now < next_tick_time) {
+            // Sleep for the whole milliseconds left, and only yield for the
+            // rest so as not to oversleep.
+            uint32_t delay = (next_tick_time - now) * 1000 / frequency;
+            SDL_Delay(delay);
+            continue;
+        }
+        if (now - next_tick_time > max_backlog) {
+            next_tick_time = now - max_backlog;
+        }
+
+        uint32_t end_time =
+            SDL_GetTicks() - (uint32_t)((now - next_tick_time) * 1000 /
+                                        frequency);
+        run_tick(thread, end_time, &previous_sim, &shown_sim);
+        ticks++;
+        struct sim_snapshot snapshot = make_snapshot(
+            game, &previous_sim, &shown_sim, next_tick_time, ticks);
+        publish_snapshot(thread, &snapshot);
+        next_tick_time += tick_length;
+    }
+    return 0;
+}
+
+bool start_sim_thread(struct sim_thread *thread, struct game *game,
+                      double tick_duration, struct recorder *recorder) {
+    *thread = (struct sim_thread){
+        .game = game,
+        .recorder = recorder,
+        .tick_duration = tick_duration,
+        .back_slot = 1,
+        .front_slot = 0,
+    };
+    SDL_AtomicSet(&thread->middle_slot, 2);
+    struct sim_snapshot snapshot = make_snapshot(
+        game, &game->sim, &game->sim, SDL_GetPerformanceCounter(), 0);
+    for (int i = 0; i < 3; i++) {
+        thread->snapshots[i] = snapshot;
+    }
+
+    // The window is left to the thread that created it.
+    game->window_on_other_thread = true;
+
+    thread->thread = SDL_CreateThread(run_sim_thread, "sim", thread);
+    return thread->thread != NULL;
+}
+
+void stop_sim_thread(struct sim_thread *thread) {
+    if (thread->thread == NULL) {
+        return;
+    }
+    SDL_AtomicSet(&thread->quit_requested, 1);
+    SDL_WaitThread(thread->thread, NULL);
+    thread->thread = NULL;
+}
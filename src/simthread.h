@@ -0,0 +1,56 @@
+#pragma once
+
+#include <SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "game.h"
+#include "record.h"
+#include "sim.h"
+
+#define SIM_THREAD_QUEUE_LENGTH 256 // must be a power of two
+
+// What the render thread needs of the game to draw a frame, as of the end of
+// a tick. It is never changed once published.
+struct sim_snapshot {
+    struct sim previous_sim; // as of the tick before
+    struct sim sim;
+    uint64_t time;  // when the tick was due, in performance counter ticks
+    int64_t ticks;  // simulated since the start
+    bool paused;
+    bool debug_mode;
+    bool replaying;
+};
+
+// The simulation stepped at a fixed rate on a thread of its own, with the
+// ghosts, the controls and the events of the game. The render thread forwards
+// it the events it polls through a single producer, single consumer lock-free
+// queue, and takes the latest snapshot from a lock-free triple buffer: the
+// slots are only ever swapped, so neither thread waits for the other.
+struct sim_thread {
+    struct game *game; // only touched by the simulation thread while running
+    struct recorder *recorder; // or NULL
+    double tick_duration;      // in seconds
+    SDL_Thread *thread;
+    SDL_atomic_t quit_requested;
+    SDL_atomic_t window_hidden; // set by the render thread
+
+    SDL_Event queue[SIM_THREAD_QUEUE_LENGTH];
+    SDL_atomic_t queue_head; // only written by the render thread
+    SDL_atomic_t queue_tail; // only written by the simulation thread
+
+    struct sim_snapshot snapshots[3];
+    // The slot between the two threads, flagged when it holds a snapshot the
+    // render thread hasn't taken yet.
+    SDL_atomic_t middle_slot;
+    int back_slot;  // written by the simulation thread
+    int front_slot; // read by the render thread
+};
+
+// The game must stay at the same address and may only be touched through the
+// thread until it is stopped. Return false if the thread couldn't be started.
+bool start_sim_thread(struct sim_thread *thread, struct game *game,
+                      double tick_duration, struct recorder *recorder);
+void stop_sim_thread(struct sim_thread *thread);
+bool post_sim_thread_event(struct sim_thread *thread, SDL_Event event);
+const struct sim_snapshot *get_sim_snapshot(struct sim_thread *thread);
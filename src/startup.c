@@ -0,0 +1,113 @@
+#include "startup.h"
+
+static double get_elapsed_time(const struct startup *startup) {
+    return (SDL_GetPerformanceCounter() - startup->start_time) /
+           (double)SDL_GetPerformanceFrequency();
+}
+
+// Start timing from now, which should be as early as possible.
+struct startup make_startup(bool measure) {
+    return (struct startup){
+        .measure = measure,
+        .start_time = SDL_GetPerformanceCounter(),
+    };
+}
+
+void note_video_started(struct startup *startup) {
+    startup->video_time = get_elapsed_time(startup);
+}
+
+// The device starts playing the tones of the game as soon as it is open.
+static void open_audio(struct startup *startup) {
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Couldn't initialize audio: %s", SDL_GetError());
+    } else {
+        startup->audio_device_id = SDL_OpenAudioDevice(
+            NULL, 0, &startup->audio_spec, NULL, 0);
+        if (startup->audio_device_id == 0) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Couldn't open an audio device: %s", SDL_GetError());
+        }
+        // Unpause the audio device because it is paused by default.
+        SDL_PauseAudioDevice(startup->audio_device_id, 0);
+    }
+    startup->audio_done_time = get_elapsed_time(startup);
+}
+
+static int run_audio_thread(void *data) {
+    struct startup *startup = data;
+    open_audio(startup);
+    // Publish the device only once it is open.
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&startup->audio_done, 1);
+    return 0;
+}
+
+// Open the audio device on a thread of its own, or on the main thread once
+// the first frame is presented if there are no threads. The audio callback
+// synthesizes the tones of the game in place, so the generator must stay
+// where it is.
+void start_audio(struct startup *startup, struct tonegen *gen, int period) {
+    startup->tonegen = gen;
+    startup->audio_spec = make_tonegen_audio_spec(gen, period);
+    startup->audio_thread = SDL_CreateThread(run_audio_thread, "audio startup",
+                                             startup);
+    startup->audio_pending = startup->audio_thread == NULL;
+}
+
+static void report_startup(const struct startup *startup) {
+    SDL_Log("Startup: video in %.1f ms, first frame presented in %.1f ms, "
+            "audio in %.1f ms, controllers in %.1f ms",
+            startup->video_time * 1000, startup->first_present_time * 1000,
+            startup->audio_time * 1000, startup->controllers_time * 1000);
+}
+
+// Carry on with the startup after a frame is presented, a stage per frame so
+// that none holds up the frame after the first one, and log how long each
+// stage took once they are all done if measuring them.
+void update_startup(struct startup *startup) {
+    if (startup->controllers_time > 0) {
+        return;
+    }
+    if (startup->first_present_time == 0) {
+        startup->first_present_time = get_elapsed_time(startup);
+        return;
+    }
+    if (startup->audio_pending) {
+        open_audio(startup);
+        startup->audio_pending = false;
+        startup->audio_time = startup->audio_done_time;
+        return;
+    }
+    // SDL's subsystems can't be initialized from two threads at once, so the
+    // controllers wait for the audio.
+    if (startup->audio_thread != NULL) {
+        if (!SDL_AtomicGet(&startup->audio_done)) {
+            return;
+        }
+        SDL_WaitThread(startup->audio_thread, NULL);
+        startup->audio_thread = NULL;
+        startup->audio_time = startup->audio_done_time;
+    }
+
+    // The controllers already connected are added through events.
+    if (SDL_InitSubSystem(SDL_INIT_GAMECONTROLLER) < 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Couldn't initialize controllers: %s", SDL_GetError());
+    }
+    startup->controllers_time = get_elapsed_time(startup);
+    if (startup->measure) {
+        report_startup(startup);
+    }
+}
+
+// Wait for the audio device if it is still being opened, and return it to be
+// closed.
+SDL_AudioDeviceID finish_startup(struct startup *startup) {
+    if (startup->audio_thread != NULL) {
+        SDL_WaitThread(startup->audio_thread, NULL);
+        startup->audio_thread = NULL;
+    }
+    return startup->audio_device_id;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <SDL.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tonegen.h"
+
+// The game starts in stages so that its first frame isn't held up by the
+// audio devices and the controllers, which can take hundreds of milliseconds
+// to enumerate: the audio device is opened by a thread of its own while the
+// first frame is drawn, and the controllers are only initialized on a later
+// frame once the audio is ready, attaching themselves to the game through
+// their events.
+struct startup {
+    bool measure;
+    uint64_t start_time; // in performance counter ticks
+    // Since the start, in seconds, or 0 until the stage is done.
+    double video_time;
+    double first_present_time;
+    double audio_time;
+    double controllers_time;
+
+    struct tonegen *tonegen;
+    SDL_AudioSpec audio_spec;
+    SDL_Thread *audio_thread; // or NULL once joined, or if there is none
+    bool audio_pending;       // to be opened on the main thread
+    SDL_atomic_t audio_done;
+    // Only written by the audio thread until it is done.
+    SDL_AudioDeviceID audio_device_id; // or 0 if there is none
+    double audio_done_time;
+};
+
+struct startup make_startup(bool measure);
+void note_video_started(struct startup *startup);
+void start_audio(struct startup *startup, struct tonegen *gen, int period);
+void update_startup(struct startup *startup);
+SDL_AudioDeviceID finish_startup(struct startup *startup);
@@ -0,0 +1,188 @@
+#include "synth.h"
+
+#include "math.h"
+
+// The phases are computed with 24 bits, as many as a float can hold.
+#define PHASE_BITS 24
+#define PHASE_ONE (1 << PHASE_BITS)
+
+// The square wave steps every half cycle, in 2^-32 cycles.
+#define HALF_CYCLE 0x80000000u
+
+const struct game_tone PADDLE_MISSED_BALL_TONE = {240, 510};
+const struct game_tone BALL_HIT_PADDLE_TONE = {480, 35};
+const struct game_tone BALL_HIT_WALL_TONE = {240, 20};
+
+struct oscillator make_oscillator(float freq, int sample_rate) {
+    return (struct oscillator){
+        .increment = (double)freq / sample_rate * 4294967296.0, // 2^32
+    };
+}
+
+static int32_t truncate_phase(uint32_t phase) {
+    return phase >> (32 - PHASE_BITS);
+}
+
+// Return 1 if a < b, otherwise 0. It is computed from the sign of the
+// difference rather than with a comparison, which GCC doesn't vectorize.
+static float less_than(int32_t a, int32_t b) {
+    return (int32_t)((uint32_t)(a - b) >> 31);
+}
+
+// The correction of a unit step of the wave at phase 0, which spreads it over
+// the samples on both sides of the step to band-limit it (PolyBLEP).
+static float polyblep(int32_t phase, int32_t increment,
+                      float inverse_increment) {
+    float after = phase * inverse_increment;
+    float before = (phase - PHASE_ONE) * inverse_increment;
+    float after_correction = after + after - after * after - 1.0f;
+    float before_correction = before * before + before + before + 1.0f;
+    return less_than(phase, increment) * after_correction +
+           less_than(PHASE_ONE - increment, phase) * before_correction;
+}
+
+// Return a sample of a square wave of unit amplitude, band-limited.
+static float get_square_wave_value(uint32_t phase, int32_t increment,
+                                   float inverse_increment) {
+    float value = 1.0f - 2.0f * (int32_t)(phase >> 31);
+    value += polyblep(truncate_phase(phase), increment, inverse_increment);
+    value -= polyblep(truncate_phase(phase + HALF_CYCLE), increment,
+                      inverse_increment);
+    return value;
+}
+
+// Compute a block of a square wave of unit amplitude.
+static void square_wave_block(struct oscillator *osc, float *values,
+                              int length) {
+    // Every phase is computed from the one at the start of the block, so
+    // that the samples don't depend on each other.
+    for (int i = 0; i < length; i++) {
+        uint32_t phase = osc->phase + (uint32_t)i * osc->increment;
+        values[i] = 1.0f - 2.0f * (int32_t)(phase >> 31);
+    }
+
+    // The PolyBLEP only corrects the samples on both sides of a step, which
+    // are a couple in a block, so only those are computed again.
+    if (osc->increment > 0) {
+        int32_t increment = truncate_phase(osc->increment);
+        float inverse_increment = 1.0f / increment;
+        // The distance from the start of the block to the last step before
+        // it, in 2^-32 cycles, which is only corrected if the first sample
+        // follows it.
+        int64_t step = -(int64_t)(osc->phase % HALF_CYCLE);
+        if (step + osc->increment <= 0) {
+            step += HALF_CYCLE;
+        }
+        for (;; step += HALF_CYCLE) {
+            // The first sample at or after the step.
+            int64_t after =
+                step > 0 ? (step + osc->increment - 1) / osc->increment : 0;
+            if (after > length) {
+                break;
+            }
+            for (int64_t i = after > 0 ? after - 1 : 0;
+                 i <= after && i < length; i++) {
+                uint32_t phase = osc->phase + (uint32_t)i * osc->increment;
+                values[i] =
+                    get_square_wave_value(phase, increment, inverse_increment);
+            }
+        }
+    }
+
+    osc->phase += (uint32_t)length * osc->increment;
+}
+
+// Convert a block of samples to int16, saturating the ones out of range.
+static void saturate_block(const float *values, float amplitude,
+                           int16_t *samples, int length) {
+    for (int i = 0; i < length; i++) {
+        int32_t sample = values[i] * amplitude;
+        sample = sample > INT16_MAX ? INT16_MAX : sample;
+        sample = sample < INT16_MIN ? INT16_MIN : sample;
+        samples[i] = sample;
+    }
+}
+
+// Generate a band-limited square wave of the given amplitude, in sample
+// units.
+void generate_square_wave(struct oscillator *osc, float amplitude,
+                          int16_t *samples, int length) {
+    float values[SYNTH_BLOCK_LENGTH];
+    for (int i = 0; i < length; i += SYNTH_BLOCK_LENGTH) {
+        int block_length = length - i;
+        if (block_length > SYNTH_BLOCK_LENGTH) {
+            block_length = SYNTH_BLOCK_LENGTH;
+        }
+        square_wave_block(osc, values, block_length);
+        saturate_block(values, amplitude, samples + i, block_length);
+    }
+}
+
+// Start a square wave voice, replacing the voice closest to its end if none
+// is free.
+void start_voice(struct mixer *mixer, float freq, int length,
+                 int sample_rate) {
+    struct voice *voice = &mixer->voices[0];
+    for (int i = 1; i < SYNTH_MAX_VOICES && voice->length > 0; i++) {
+        struct voice *other = &mixer->voices[i];
+        if (other->length - other->position <
+            voice->length - voice->position) {
+            voice = other;
+        }
+    }
+    *voice = (struct voice){
+        .osc = make_oscillator(freq, sample_rate),
+        .length = length,
+    };
+}
+
+// Return the gain of a voice at a position, which ramps up at its start and
+// down at its end so that it doesn't click.
+static float get_envelope_gain(struct voice voice, int position) {
+    float gain = 1.0f;
+    gain = fminf(gain, position / (float)SYNTH_ATTACK_LENGTH);
+    gain = fminf(gain, (voice.length - position) / (float)SYNTH_RELEASE_LENGTH);
+    return fmaxf(gain, 0.0f);
+}
+
+// Mix the voices being played into the samples with the given amplitude per
+// voice. The envelope of each voice is computed once per block and ramped
+// linearly across it.
+void mix_voices(struct mixer *mixer, float amplitude, int16_t *samples,
+                int length) {
+    float values[SYNTH_BLOCK_LENGTH];
+    float mix[SYNTH_BLOCK_LENGTH];
+
+    for (int i = 0; i < length; i += SYNTH_BLOCK_LENGTH) {
+        int block_length = length - i;
+        if (block_length > SYNTH_BLOCK_LENGTH) {
+            block_length = SYNTH_BLOCK_LENGTH;
+        }
+        for (int j = 0; j < block_length; j++) {
+            mix[j] = 0.0f;
+        }
+
+        for (int v = 0; v < SYNTH_MAX_VOICES; v++) {
+            struct voice *voice = &mixer->voices[v];
+            if (voice->length == 0) {
+                continue;
+            }
+            float gain = get_envelope_gain(*voice, voice->position);
+            float end_gain =
+                get_envelope_gain(*voice, voice->position + block_length);
+            float gain_step = (end_gain - gain) / block_length;
+
+            square_wave_block(&voice->osc, values, block_length);
+            for (int j = 0; j < block_length; j++) {
+                mix[j] += values[j] * (gain + j * gain_step);
+            }
+
+            voice->position += block_length;
+            if (voice->position >= voice->length) {
+                voice->length = 0;
+            }
+        }
+
+        saturate_block(mix, amplitude, samples + i, block_length);
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <stdint.h>
+
+// Sound synthesis of the tones of the game, which must not depend on SDL so
+// that it can be benchmarked headless.
+
+// The number of samples computed at once, with no dependency between them
+// so that the compiler may vectorize their computation.
+#define SYNTH_BLOCK_LENGTH 64
+
+// The phase is a fixed-point fraction of a cycle which wraps around by itself,
+// so that it neither drifts nor loses precision however long a tone lasts.
+struct oscillator {
+    uint32_t phase;     // in 2^-32 cycles
+    uint32_t increment; // in 2^-32 cycles per sample
+};
+
+// Game sounds may overlap, so they are played by a fixed pool of voices mixed
+// together.
+#define SYNTH_MAX_VOICES 8
+#define SYNTH_ATTACK_LENGTH 64   // in samples
+#define SYNTH_RELEASE_LENGTH 256 // in samples
+
+struct voice {
+    struct oscillator osc;
+    int length;   // in samples, or 0 if the voice is free
+    int position; // in samples
+};
+
+struct mixer {
+    struct voice voices[SYNTH_MAX_VOICES];
+};
+
+// The tones the game plays when something happens in the simulation.
+struct game_tone {
+    int freq;        // in Hz
+    int duration_ms; // in ms
+};
+
+extern const struct game_tone PADDLE_MISSED_BALL_TONE;
+extern const struct game_tone BALL_HIT_PADDLE_TONE;
+extern const struct game_tone BALL_HIT_WALL_TONE;
+
+struct oscillator make_oscillator(float freq, int sample_rate);
+void generate_square_wave(struct oscillator *osc, float amplitude,
+                          int16_t *samples, int length);
+void start_voice(struct mixer *mixer, float freq, int length,
+                 int sample_rate);
+void mix_voices(struct mixer *mixer, float amplitude, int16_t *samples,
+                int length);
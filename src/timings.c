@@ -0,0 +1,109 @@
+#include "timings.h"
+
+#include <stdlib.h>
+
+#include "digits.h"
+
+static const int ROW_HEIGHT = 12;
+static const int ROW_GAP = 8;
+static const int DIGITS_WIDTH = 90; // room for the numbers, right-aligned
+
+// The color each row is marked with, in the order of the rows.
+static const struct color PHASE_COLORS[FRAME_PHASES_LENGTH] = {
+    {255, 64, 64, 255},  // events
+    {255, 160, 0, 255},  // controls
+    {255, 255, 0, 255},  // simulation
+    {0, 255, 0, 255},    // rendering
+    {0, 255, 255, 255},  // audio
+    {64, 128, 255, 255}, // present
+};
+static const struct color FRAME_TIME_COLOR = {255, 255, 255, 255};
+static const struct color TICKS_COLOR = {255, 0, 255, 255};
+
+// Add to the time spent in a phase of the frame being timed.
+void add_phase_time(struct frame_timings *timings, enum frame_phase phase,
+                    double time) {
+    timings->phase_times[phase] += time;
+}
+
+// Move the frame being timed to the history and start timing the next one.
+void end_frame_timings(struct frame_timings *timings, double frame_time) {
+    int frame = timings->next_frame;
+    for (int phase = 0; phase < FRAME_PHASES_LENGTH; phase++) {
+        timings->phase_history[phase][frame] = timings->phase_times[phase];
+        timings->phase_times[phase] = 0.0;
+    }
+    timings->frame_time_history[frame] = frame_time;
+    timings->last_ticks = timings->ticks;
+    timings->ticks = 0;
+
+    timings->next_frame = (frame + 1) % FRAME_TIMINGS_WINDOW_LENGTH;
+    if (timings->history_length < FRAME_TIMINGS_WINDOW_LENGTH) {
+        timings->history_length++;
+    }
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double get_mean(const double *values, int length) {
+    double sum = 0.0;
+    for (int i = 0; i < length; i++) {
+        sum += values[i];
+    }
+    return sum / length;
+}
+
+// Render a row made of a colored mark followed by a number of microseconds,
+// or of anything else.
+static void render_row(struct draw_list *list, struct vec2 position,
+                       struct color color, int row, double number) {
+    position.y += row * (ROW_HEIGHT + ROW_GAP);
+    set_draw_color(list, color);
+    draw_rect(list, (struct rect){
+                        .x = position.x,
+                        .y = position.y,
+                        .w = ROW_HEIGHT,
+                        .h = ROW_HEIGHT,
+                    });
+    position.x += DIGITS_WIDTH;
+    render_digits(list, position, ROW_HEIGHT, (int)(number + 0.5));
+}
+
+// Render the mean time of each phase over the window, then the minimum, mean
+// and 99th percentile of the frame time, all in microseconds, and the number
+// of ticks simulated by the last frame.
+void render_frame_timings(struct draw_list *list,
+                          const struct frame_timings *timings,
+                          struct vec2 position) {
+    int length = timings->history_length;
+    if (length == 0) {
+        return;
+    }
+    struct color color = list->colors[list->color];
+
+    int row = 0;
+    for (int phase = 0; phase < FRAME_PHASES_LENGTH; phase++) {
+        double mean = get_mean(timings->phase_history[phase], length);
+        render_row(list, position, PHASE_COLORS[phase], row++, mean * 1e6);
+    }
+
+    double frame_times[FRAME_TIMINGS_WINDOW_LENGTH];
+    for (int i = 0; i < length; i++) {
+        frame_times[i] = timings->frame_time_history[i];
+    }
+    qsort(frame_times, length, sizeof(double), compare_doubles);
+    double min = frame_times[0];
+    double mean = get_mean(frame_times, length);
+    double p99 = frame_times[(length - 1) * 99 / 100];
+    render_row(list, position, FRAME_TIME_COLOR, row++, min * 1e6);
+    render_row(list, position, FRAME_TIME_COLOR, row++, mean * 1e6);
+    render_row(list, position, FRAME_TIME_COLOR, row++, p99 * 1e6);
+
+    render_row(list, position, TICKS_COLOR, row++, timings->last_ticks);
+
+    set_draw_color(list, color);
+}
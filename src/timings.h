@@ -0,0 +1,40 @@
+#pragma once
+
+#include "draw.h"
+
+// Where the time of the frames goes, kept over a rolling window of frames to
+// be shown in debug mode. Nothing in here may depend on SDL, the times are
+// measured by the caller.
+
+#define FRAME_TIMINGS_WINDOW_LENGTH 256 // in frames
+
+enum frame_phase {
+    FRAME_PHASE_EVENTS,
+    FRAME_PHASE_CONTROLS, // including the ghosts
+    FRAME_PHASE_SIMULATION,
+    FRAME_PHASE_RENDERING,
+    FRAME_PHASE_AUDIO, // the last audio callback, on the audio thread
+    FRAME_PHASE_PRESENT,
+    FRAME_PHASES_LENGTH,
+};
+
+struct frame_timings {
+    // The frame being timed.
+    double phase_times[FRAME_PHASES_LENGTH]; // in seconds
+    int ticks;
+
+    // The last frames in a ring, the next frame replacing the oldest one
+    // once the window is full.
+    double phase_history[FRAME_PHASES_LENGTH][FRAME_TIMINGS_WINDOW_LENGTH];
+    double frame_time_history[FRAME_TIMINGS_WINDOW_LENGTH]; // in seconds
+    int last_ticks;
+    int history_length;
+    int next_frame;
+};
+
+void add_phase_time(struct frame_timings *timings, enum frame_phase phase,
+                    double time);
+void end_frame_timings(struct frame_timings *timings, double frame_time);
+void render_frame_timings(struct draw_list *list,
+                          const struct frame_timings *timings,
+                          struct vec2 position);
@@ -2,65 +2,114 @@
 
 static const int FORMAT_MAX_VALUE = INT16_MAX; // determ. by TONEGEN_FORMAT_SIZE
 
-const SDL_AudioSpec TONEGEN_AUDIO_SPEC = {
-    .freq = TONEGEN_SAMPLES_PER_SECOND,
-    .format = AUDIO_S16SYS,
-    .channels = 1,
-    .samples = 4096,
-};
+static void tonegen_callback(void *userdata, uint8_t *stream, int len);
 
 struct tonegen make_tonegen(float volume_percentage) {
     return (struct tonegen){
         .amplitude = (volume_percentage / 100.0f) * FORMAT_MAX_VALUE,
+        .period = TONEGEN_DEFAULT_PERIOD,
     };
 }
 
+// The generator must stay at the same address while the device is open.
+SDL_AudioSpec make_tonegen_audio_spec(struct tonegen *gen, int period) {
+    gen->period = period;
+    return (SDL_AudioSpec){
+        .freq = TONEGEN_SAMPLES_PER_SECOND,
+        .format = AUDIO_S16SYS,
+        .channels = 1,
+        .samples = period,
+        .callback = tonegen_callback,
+        .userdata = gen,
+    };
+}
+
+// Post a tone to be played over the ones being played. The tone is dropped if
+// the device isn't playing yet, or if the audio thread is so late that the
+// queue is full.
 void set_tonegen_tone(struct tonegen *gen, int freq, int duration_ms) {
-    gen->freq = freq;
-    gen->remaining_samples =
-        (duration_ms / 1000.0) * TONEGEN_SAMPLES_PER_SECOND;
+    if (!SDL_AtomicGet(&gen->started)) {
+        return;
+    }
+    int head = SDL_AtomicGet(&gen->queue_head);
+    int tail = SDL_AtomicGet(&gen->queue_tail);
+    if (head - tail == TONEGEN_QUEUE_LENGTH) {
+        return;
+    }
+
+    gen->queue[head % TONEGEN_QUEUE_LENGTH] = (struct tone){
+        .freq = freq,
+        .length = (duration_ms / 1000.0) * TONEGEN_SAMPLES_PER_SECOND,
+        .time = SDL_GetPerformanceCounter(),
+    };
+    // Publish the tone only once it is written.
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&gen->queue_head, head + 1);
 }
 
-static int square_wave_sample(int sample_idx, int freq, int amplitude) {
-    int wave_period = TONEGEN_SAMPLES_PER_SECOND / freq;
-    int half_period = wave_period / 2;
-    if ((sample_idx / half_period) % 2 == 0) {
-        return amplitude;
+void toggle_tonegen_mute(struct tonegen *gen) {
+    SDL_AtomicSet(&gen->mute, !SDL_AtomicGet(&gen->mute));
+}
+
+// Log the latencies measured so far. The output latency adds the period the
+// samples wait for in the buffer before being played, but not the unknown
+// latency of the device itself.
+void report_tonegen_latency(const struct tonegen *gen) {
+    if (!gen->measure_latency || gen->latency_count == 0) {
+        return;
     }
-    return -amplitude;
+    double mean = gen->latency_sum / gen->latency_count;
+    double buffer = gen->period / (double)TONEGEN_SAMPLES_PER_SECOND;
+    SDL_Log("Audio latency over %ld tones: %.2f ms mean, %.2f ms max to "
+            "synthesis, %.2f ms mean, %.2f ms max to output",
+            gen->latency_count, mean * 1000, gen->latency_max * 1000,
+            (mean + buffer) * 1000, (gen->latency_max + buffer) * 1000);
 }
 
-void tonegen_generate(struct tonegen *gen, SDL_AudioDeviceID device_id) {
-    size_t queue_size = SDL_GetQueuedAudioSize(device_id);
-    int max_len =
-        TONEGEN_BUFFER_MAX_LENGTH - (queue_size / TONEGEN_FORMAT_SIZE);
-    if (max_len < 0) {
-        max_len = 0;
+// Start playing the tones posted since the last callback.
+static void receive_tones(struct tonegen *gen) {
+    int tail = SDL_AtomicGet(&gen->queue_tail);
+    int head = SDL_AtomicGet(&gen->queue_head);
+    if (tail == head) {
+        return;
     }
-    int len = gen->remaining_samples;
-    if (len > max_len) {
-        len = max_len;
+    // Don't read the tones before they are published.
+    SDL_MemoryBarrierAcquire();
+
+    uint64_t now = SDL_GetPerformanceCounter();
+    for (; tail != head; tail++) {
+        struct tone tone = gen->queue[tail % TONEGEN_QUEUE_LENGTH];
+        start_voice(&gen->mixer, tone.freq, tone.length,
+                    TONEGEN_SAMPLES_PER_SECOND);
+
+        if (gen->measure_latency) {
+            double latency = (now - tone.time) /
+                             (double)SDL_GetPerformanceFrequency();
+            gen->latency_count++;
+            gen->latency_sum += latency;
+            gen->latency_max = fmax(gen->latency_max, latency);
+        }
     }
-    gen->remaining_samples -= len;
-    gen->buffer_size = len * TONEGEN_FORMAT_SIZE;
+    SDL_AtomicSet(&gen->queue_tail, tail);
+}
+
+static void tonegen_callback(void *userdata, uint8_t *stream, int len) {
+    struct tonegen *gen = userdata;
+    uint64_t start_time = SDL_GetPerformanceCounter();
+    int16_t *samples = (int16_t *)stream;
+    int length = len / TONEGEN_FORMAT_SIZE;
+    SDL_AtomicSet(&gen->started, 1);
+
+    receive_tones(gen);
 
     int amplitude = gen->amplitude;
-    if (gen->mute) {
+    if (SDL_AtomicGet(&gen->mute)) {
         amplitude = 0;
     }
 
-    for (int i = 0; i < len; i++) {
-        gen->buffer[i] =
-            square_wave_sample(gen->sample_idx + i, gen->freq, amplitude);
-    }
-    gen->sample_idx += len;
-}
+    mix_voices(&gen->mixer, amplitude, samples, length);
 
-void tonegen_queue(struct tonegen *gen, SDL_AudioDeviceID device_id) {
-    if (gen->buffer_size > 0) {
-        if (SDL_QueueAudio(device_id, gen->buffer, gen->buffer_size) < 0) {
-            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                         "Couldn't queue audio: %s", SDL_GetError());
-        }
-    }
+    uint64_t time = (SDL_GetPerformanceCounter() - start_time) * 1000000 /
+                    SDL_GetPerformanceFrequency();
+    SDL_AtomicSet(&gen->callback_time, time);
 }
@@ -4,24 +4,51 @@
 #include <stdbool.h>
 
 #include "math.h"
+#include "synth.h"
 
 #define TONEGEN_SAMPLES_PER_SECOND 44100
 #define TONEGEN_FORMAT_SIZE sizeof(int16_t) // sample format
-#define TONEGEN_BUFFER_MAX_LENGTH (TONEGEN_SAMPLES_PER_SECOND / 10)
+#define TONEGEN_MIN_PERIOD 128              // in samples
+#define TONEGEN_MAX_PERIOD 512              // in samples
+#define TONEGEN_DEFAULT_PERIOD 256          // in samples
+#define TONEGEN_QUEUE_LENGTH 16             // must be a power of two
 
-extern const SDL_AudioSpec TONEGEN_AUDIO_SPEC;
+struct tone {
+    int freq;
+    int length;    // in samples
+    uint64_t time; // when it was set, in performance counter ticks
+};
 
+// The samples are synthesized by the audio callback on the audio thread. The
+// game thread only posts tones to it through a single producer, single
+// consumer lock-free queue, and each tone is played by a voice of its mixer.
 struct tonegen {
     int amplitude;
-    int freq;
-    uint32_t sample_idx;
-    int remaining_samples; // samples yet to be generated
-    int16_t buffer[TONEGEN_BUFFER_MAX_LENGTH];
-    size_t buffer_size;
-    bool mute;
+    int period; // samples synthesized per callback
+    SDL_atomic_t mute;
+    // Set by the first callback. The tones set before then are dropped
+    // rather than played late.
+    SDL_atomic_t started;
+
+    struct tone queue[TONEGEN_QUEUE_LENGTH];
+    SDL_atomic_t queue_head; // only written by the game thread
+    SDL_atomic_t queue_tail; // only written by the audio thread
+
+    // Only touched by the audio thread while the device is open.
+    struct mixer mixer;
+
+    SDL_atomic_t callback_time; // of the last callback, in microseconds
+
+    // Delays between tones being set and their first sample being
+    // synthesized, measured by the audio thread when enabled.
+    bool measure_latency;
+    long latency_count;
+    double latency_sum; // in seconds
+    double latency_max; // in seconds
 };
 
 struct tonegen make_tonegen(float volume_percentage);
+SDL_AudioSpec make_tonegen_audio_spec(struct tonegen *gen, int period);
 void set_tonegen_tone(struct tonegen *gen, int freq, int duration_ms);
-void tonegen_generate(struct tonegen *gen, SDL_AudioDeviceID device_id);
-void tonegen_queue(struct tonegen *gen, SDL_AudioDeviceID device_id);
+void toggle_tonegen_mute(struct tonegen *gen);
+void report_tonegen_latency(const struct tonegen *gen);
@@ -0,0 +1,270 @@
+#include "export.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "platform.h"
+
+#define WAV_HEADER_SIZE 44
+
+struct exporter {
+    FILE *video;
+    FILE *audio; // or NULL
+    bool failed;
+    long samples_written;
+
+    // The gray frames are written as YUV 4:2:0 with a constant chroma.
+    uint8_t *chroma;
+    size_t chroma_size;
+    uint8_t *sample_bytes; // the samples of a frame in little-endian
+
+    struct export_frame *frames;
+    int frames_length;
+    long head; // frames queued, only written by the producer
+    long tail; // frames written, only written by the writer
+    bool closing;
+    long waits;
+    struct platform_mutex *mutex;
+    struct platform_cond *queued; // signaled when a frame is queued
+    struct platform_cond *freed;  // signaled when a frame is written
+    struct platform_thread *thread;
+};
+
+static void put_u16(uint8_t *bytes, uint16_t value) {
+    bytes[0] = value;
+    bytes[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *bytes, uint32_t value) {
+    put_u16(bytes, value);
+    put_u16(bytes + 2, value >> 16);
+}
+
+// The sizes aren't known until the end, so they are left at their maximum for
+// the players that read WAV from pipes, and patched when the file is closed.
+static void make_wav_header(uint8_t *header, uint32_t data_size) {
+    memcpy(header, "RIFF", 4);
+    put_u32(header + 4, (data_size == UINT32_MAX) ? UINT32_MAX
+                                                  : 36 + data_size);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put_u32(header + 16, 16);
+    put_u16(header + 20, 1); // PCM
+    put_u16(header + 22, 1); // mono
+    put_u32(header + 24, EXPORT_SAMPLE_RATE);
+    put_u32(header + 28, EXPORT_SAMPLE_RATE * sizeof(int16_t));
+    put_u16(header + 32, sizeof(int16_t));
+    put_u16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    put_u32(header + 40, data_size);
+}
+
+static void write_frame(struct exporter *exporter,
+                        const struct export_frame *frame) {
+    const struct framebuffer *framebuffer = &frame->framebuffer;
+    bool ok = fputs("FRAME\n", exporter->video) >= 0;
+    for (int y = 0; y < framebuffer->height; y++) {
+        ok = ok && fwrite(framebuffer->pixels + (size_t)y * framebuffer->pitch,
+                          framebuffer->width, 1, exporter->video) == 1;
+    }
+    ok = ok &&
+         fwrite(exporter->chroma, exporter->chroma_size, 1,
+                exporter->video) == 1 &&
+         fwrite(exporter->chroma, exporter->chroma_size, 1,
+                exporter->video) == 1;
+
+    if (exporter->audio != NULL && frame->samples_length > 0) {
+        for (int i = 0; i < frame->samples_length; i++) {
+            put_u16(exporter->sample_bytes + 2 * i, frame->samples[i]);
+        }
+        ok = ok && fwrite(exporter->sample_bytes, 2 * frame->samples_length,
+                          1, exporter->audio) == 1;
+        exporter->samples_written += frame->samples_length;
+    }
+    if (!ok) {
+        exporter->failed = true;
+    }
+}
+
+static int run_writer(void *data) {
+    struct exporter *exporter = data;
+    platform_lock_mutex(exporter->mutex);
+    for (;;) {
+        while (exporter->tail == exporter->head && !exporter->closing) {
+            platform_wait_cond(exporter->queued, exporter->mutex);
+        }
+        if (exporter->tail == exporter->head) {
+            break;
+        }
+        // The slot belongs to the writer until the tail moves past it.
+        struct export_frame *frame =
+            &exporter->frames[exporter->tail % exporter->frames_length];
+        platform_unlock_mutex(exporter->mutex);
+        write_frame(exporter, frame);
+        platform_lock_mutex(exporter->mutex);
+        exporter->tail++;
+        platform_signal_cond(exporter->freed);
+    }
+    platform_unlock_mutex(exporter->mutex);
+    return 0;
+}
+
+static FILE *open_video(const char *path) {
+    if (strcmp(path, "-") == 0) {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        return stdout;
+    }
+    return fopen(path, "wb");
+}
+
+static void free_exporter(struct exporter *exporter) {
+    if (exporter->video != NULL && exporter->video != stdout) {
+        fclose(exporter->video);
+    }
+    if (exporter->audio != NULL) {
+        fclose(exporter->audio);
+    }
+    if (exporter->frames != NULL) {
+        for (int i = 0; i < exporter->frames_length; i++) {
+            free(exporter->frames[i].framebuffer.pixels);
+            free(exporter->frames[i].samples);
+        }
+    }
+    if (exporter->mutex != NULL) {
+        platform_destroy_mutex(exporter->mutex);
+    }
+    if (exporter->queued != NULL) {
+        platform_destroy_cond(exporter->queued);
+    }
+    if (exporter->freed != NULL) {
+        platform_destroy_cond(exporter->freed);
+    }
+    free(exporter->frames);
+    free(exporter->chroma);
+    free(exporter->sample_bytes);
+    free(exporter);
+}
+
+struct exporter *open_exporter(const char *video_path, const char *audio_path,
+                               int width, int height, int frame_rate,
+                               int queue_length) {
+    struct exporter *exporter = calloc(1, sizeof(struct exporter));
+    if (exporter == NULL) {
+        return NULL;
+    }
+    exporter->frames_length = queue_length;
+    exporter->frames = calloc(queue_length, sizeof(struct export_frame));
+    exporter->chroma_size = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+    exporter->chroma = malloc(exporter->chroma_size);
+    // A frame may get one sample more than the others when the sample rate
+    // isn't a multiple of the frame rate.
+    int max_samples = EXPORT_SAMPLE_RATE / frame_rate + 1;
+    exporter->sample_bytes = malloc(max_samples * sizeof(int16_t));
+    exporter->mutex = platform_create_mutex();
+    exporter->queued = platform_create_cond();
+    exporter->freed = platform_create_cond();
+    bool ok = exporter->frames != NULL && exporter->chroma != NULL &&
+              exporter->sample_bytes != NULL && exporter->mutex != NULL &&
+              exporter->queued != NULL && exporter->freed != NULL;
+    for (int i = 0; ok && i < queue_length; i++) {
+        struct export_frame *frame = &exporter->frames[i];
+        frame->framebuffer = (struct framebuffer){
+            .pixels = malloc((size_t)width * height),
+            .width = width,
+            .height = height,
+            .pitch = width,
+            .format = PIXEL_FORMAT_GRAY8,
+        };
+        frame->samples = malloc(max_samples * sizeof(int16_t));
+        ok = frame->framebuffer.pixels != NULL && frame->samples != NULL;
+    }
+    if (!ok) {
+        free_exporter(exporter);
+        return NULL;
+    }
+    memset(exporter->chroma, 128, exporter->chroma_size);
+
+    exporter->video = open_video(video_path);
+    if (audio_path != NULL) {
+        exporter->audio = fopen(audio_path, "wb");
+    }
+    if (exporter->video == NULL ||
+        (audio_path != NULL && exporter->audio == NULL)) {
+        free_exporter(exporter);
+        return NULL;
+    }
+
+    // The luma of the game is the full range of the gray frames.
+    fprintf(exporter->video,
+            "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n",
+            width, height, frame_rate);
+    if (exporter->audio != NULL) {
+        uint8_t header[WAV_HEADER_SIZE];
+        make_wav_header(header, UINT32_MAX);
+        fwrite(header, sizeof(header), 1, exporter->audio);
+    }
+
+    exporter->thread = platform_create_thread(run_writer, exporter);
+    if (exporter->thread == NULL) {
+        free_exporter(exporter);
+        return NULL;
+    }
+    return exporter;
+}
+
+struct export_frame *begin_export_frame(struct exporter *exporter) {
+    platform_lock_mutex(exporter->mutex);
+    if (exporter->head - exporter->tail == exporter->frames_length) {
+        exporter->waits++;
+        do {
+            platform_wait_cond(exporter->freed, exporter->mutex);
+        } while (exporter->head - exporter->tail == exporter->frames_length);
+    }
+    struct export_frame *frame =
+        &exporter->frames[exporter->head % exporter->frames_length];
+    platform_unlock_mutex(exporter->mutex);
+    return frame;
+}
+
+void end_export_frame(struct exporter *exporter) {
+    platform_lock_mutex(exporter->mutex);
+    exporter->head++;
+    platform_signal_cond(exporter->queued);
+    platform_unlock_mutex(exporter->mutex);
+}
+
+long get_export_waits(const struct exporter *exporter) {
+    return exporter->waits;
+}
+
+bool close_exporter(struct exporter *exporter) {
+    platform_lock_mutex(exporter->mutex);
+    exporter->closing = true;
+    platform_signal_cond(exporter->queued);
+    platform_unlock_mutex(exporter->mutex);
+    platform_wait_thread(exporter->thread);
+
+    bool ok = !exporter->failed && fflush(exporter->video) == 0;
+    if (exporter->audio != NULL) {
+        // A pipe can't be rewound, so its sizes stay at their maximum.
+        uint8_t header[WAV_HEADER_SIZE];
+        make_wav_header(header, exporter->samples_written * sizeof(int16_t));
+        if (fseek(exporter->audio, 0, SEEK_SET) == 0) {
+            ok = ok && fwrite(header, sizeof(header), 1, exporter->audio) == 1;
+        }
+        ok = fclose(exporter->audio) == 0 && ok;
+        exporter->audio = NULL;
+    }
+    if (exporter->video != stdout) {
+        ok = fclose(exporter->video) == 0 && ok;
+    }
+    exporter->video = NULL;
+    free_exporter(exporter);
+    return ok;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "../raster.h"
+
+// Writing of frames as raw Y4M video and of their samples as WAV audio by a
+// worker thread. The frames are handed over through a bounded queue of slots
+// allocated once, so the thread producing them never waits on the files, only
+// on a free slot when the writer is behind.
+
+#define EXPORT_SAMPLE_RATE 44100
+
+// A slot of the queue, filled in place by the producer.
+struct export_frame {
+    struct framebuffer framebuffer; // gray, written as the luma of the video
+    int16_t *samples; // played while the frame is shown, mono
+    int samples_length;
+};
+
+struct exporter;
+
+// The video is written to standard output when its path is "-", and there is
+// no audio when its path is NULL. Return NULL if a file couldn't be opened.
+struct exporter *open_exporter(const char *video_path, const char *audio_path,
+                               int width, int height, int frame_rate,
+                               int queue_length);
+// Return the next free slot, waiting for one if the queue is full.
+struct export_frame *begin_export_frame(struct exporter *exporter);
+// Queue the slot returned by begin_export_frame() to be written.
+void end_export_frame(struct exporter *exporter);
+// Return how many times begin_export_frame() had to wait.
+long get_export_waits(const struct exporter *exporter);
+// Wait for the queued frames to be written and close the files. Return false
+// if anything couldn't be written.
+bool close_exporter(struct exporter *exporter);
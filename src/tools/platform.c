@@ -0,0 +1,258 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdlib.h>
+
+#include "platform.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+struct platform_thread {
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+    int (*fn)(void *);
+    void *data;
+};
+
+struct platform_mutex {
+#ifdef _WIN32
+    CRITICAL_SECTION handle;
+#else
+    pthread_mutex_t handle;
+#endif
+};
+
+struct platform_cond {
+#ifdef _WIN32
+    CONDITION_VARIABLE handle;
+#else
+    pthread_cond_t handle;
+#endif
+};
+
+double platform_time(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+#endif
+}
+
+void platform_sleep(double duration) {
+#ifdef _WIN32
+    Sleep(duration * 1000);
+#else
+    struct timespec ts = {
+        .tv_sec = duration,
+        .tv_nsec = (duration - (time_t)duration) * 1e9,
+    };
+    nanosleep(&ts, NULL);
+#endif
+}
+
+// Return the number of online logical processors, or 1 when it's unknown.
+int platform_cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? count : 1;
+#endif
+}
+
+#ifdef _WIN32
+static DWORD WINAPI run_thread(LPVOID thread) {
+    struct platform_thread *t = thread;
+    return t->fn(t->data);
+}
+#else
+static void *run_thread(void *thread) {
+    struct platform_thread *t = thread;
+    t->fn(t->data);
+    return NULL;
+}
+#endif
+
+struct platform_thread *platform_create_thread(int (*fn)(void *), void *data) {
+    struct platform_thread *thread = malloc(sizeof(struct platform_thread));
+    if (thread == NULL) {
+        return NULL;
+    }
+    thread->fn = fn;
+    thread->data = data;
+#ifdef _WIN32
+    thread->handle = CreateThread(NULL, 0, run_thread, thread, 0, NULL);
+    if (thread->handle == NULL) {
+        free(thread);
+        return NULL;
+    }
+#else
+    if (pthread_create(&thread->handle, NULL, run_thread, thread) != 0) {
+        free(thread);
+        return NULL;
+    }
+#endif
+    return thread;
+}
+
+void platform_wait_thread(struct platform_thread *thread) {
+#ifdef _WIN32
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+#else
+    pthread_join(thread->handle, NULL);
+#endif
+    free(thread);
+}
+
+struct platform_mutex *platform_create_mutex(void) {
+    struct platform_mutex *mutex = malloc(sizeof(struct platform_mutex));
+    if (mutex == NULL) {
+        return NULL;
+    }
+#ifdef _WIN32
+    InitializeCriticalSection(&mutex->handle);
+#else
+    if (pthread_mutex_init(&mutex->handle, NULL) != 0) {
+        free(mutex);
+        return NULL;
+    }
+#endif
+    return mutex;
+}
+
+void platform_destroy_mutex(struct platform_mutex *mutex) {
+#ifdef _WIN32
+    DeleteCriticalSection(&mutex->handle);
+#else
+    pthread_mutex_destroy(&mutex->handle);
+#endif
+    free(mutex);
+}
+
+void platform_lock_mutex(struct platform_mutex *mutex) {
+#ifdef _WIN32
+    EnterCriticalSection(&mutex->handle);
+#else
+    pthread_mutex_lock(&mutex->handle);
+#endif
+}
+
+void platform_unlock_mutex(struct platform_mutex *mutex) {
+#ifdef _WIN32
+    LeaveCriticalSection(&mutex->handle);
+#else
+    pthread_mutex_unlock(&mutex->handle);
+#endif
+}
+
+struct platform_cond *platform_create_cond(void) {
+    struct platform_cond *cond = malloc(sizeof(struct platform_cond));
+    if (cond == NULL) {
+        return NULL;
+    }
+#ifdef _WIN32
+    InitializeConditionVariable(&cond->handle);
+#else
+    if (pthread_cond_init(&cond->handle, NULL) != 0) {
+        free(cond);
+        return NULL;
+    }
+#endif
+    return cond;
+}
+
+void platform_destroy_cond(struct platform_cond *cond) {
+#ifndef _WIN32
+    pthread_cond_destroy(&cond->handle);
+#endif
+    free(cond);
+}
+
+void platform_wait_cond(struct platform_cond *cond,
+                        struct platform_mutex *mutex) {
+#ifdef _WIN32
+    SleepConditionVariableCS(&cond->handle, &mutex->handle, INFINITE);
+#else
+    pthread_cond_wait(&cond->handle, &mutex->handle);
+#endif
+}
+
+void platform_signal_cond(struct platform_cond *cond) {
+#ifdef _WIN32
+    WakeConditionVariable(&cond->handle);
+#else
+    pthread_cond_signal(&cond->handle);
+#endif
+}
+
+const void *platform_map_file(const char *path, size_t *size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+    LARGE_INTEGER file_size;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+    CloseHandle(file);
+    if (mapping == NULL) {
+        return NULL;
+    }
+    // The view keeps the file mapped once the handles are closed.
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    *size = file_size.QuadPart;
+    return data;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // The mapping keeps the file open once the descriptor is closed.
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    *size = st.st_size;
+    return data;
+#endif
+}
+
+void platform_unmap_file(const void *data, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(data);
+#else
+    munmap((void *)data, size);
+#endif
+}
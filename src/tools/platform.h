@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+
+// The little bit of platform support the headless tools need that the C
+// standard library doesn't provide.
+
+struct platform_thread;
+struct platform_mutex;
+struct platform_cond;
+
+double platform_time(void); // monotonic, in seconds
+void platform_sleep(double duration); // in seconds
+int platform_cpu_count(void);
+
+// Return NULL when the thread couldn't be created.
+struct platform_thread *platform_create_thread(int (*fn)(void *), void *data);
+// Wait for a thread to return and free it.
+void platform_wait_thread(struct platform_thread *thread);
+
+struct platform_mutex *platform_create_mutex(void);
+void platform_destroy_mutex(struct platform_mutex *mutex);
+void platform_lock_mutex(struct platform_mutex *mutex);
+void platform_unlock_mutex(struct platform_mutex *mutex);
+
+struct platform_cond *platform_create_cond(void);
+void platform_destroy_cond(struct platform_cond *cond);
+// Unlock the mutex while waiting to be signaled, which may also happen
+// spuriously, and lock it again.
+void platform_wait_cond(struct platform_cond *cond,
+                        struct platform_mutex *mutex);
+void platform_signal_cond(struct platform_cond *cond);
+
+// Map a whole file to memory to be read, which spares reading it all to only
+// look at part of it. Return NULL when it couldn't be mapped.
+const void *platform_map_file(const char *path, size_t *size);
+void platform_unmap_file(const void *data, size_t size);
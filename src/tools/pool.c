@@ -0,0 +1,131 @@
+#include <stdlib.h>
+
+#include "platform.h"
+#include "pool.h"
+
+// The tasks a worker has left to run. It takes them from the beginning of its
+// range while thieves take them from the end.
+struct worker {
+    struct platform_mutex *mutex;
+    long begin;
+    long end;
+    int no;
+    struct pool *pool;
+};
+
+struct pool {
+    struct worker *workers;
+    int workers_length;
+    void (*run)(long task, void *data);
+    void *data;
+};
+
+static bool take_task(struct worker *worker, long *task);
+static bool steal_tasks(struct worker *worker);
+static int run_worker(void *worker);
+
+bool run_tasks(int threads, long count, void (*run)(long task, void *data),
+               void *data) {
+    if (threads < 1) {
+        threads = 1;
+    }
+    if (threads > count) {
+        threads = (count > 0) ? count : 1;
+    }
+
+    struct pool pool = {
+        .workers = calloc(threads, sizeof(struct worker)),
+        .workers_length = threads,
+        .run = run,
+        .data = data,
+    };
+    struct platform_thread **handles =
+        calloc(threads, sizeof(struct platform_thread *));
+    if (pool.workers == NULL || handles == NULL) {
+        free(pool.workers);
+        free(handles);
+        return false;
+    }
+
+    bool ok = true;
+    for (int i = 0; i < threads; i++) {
+        struct worker *worker = &pool.workers[i];
+        worker->mutex = platform_create_mutex();
+        worker->begin = (count * i) / threads;
+        worker->end = (count * (i + 1)) / threads;
+        worker->no = i;
+        worker->pool = &pool;
+        ok = ok && worker->mutex != NULL;
+    }
+
+    // The calling thread is the first worker. Should a thread fail to start,
+    // its tasks get stolen by the others.
+    if (ok) {
+        for (int i = 1; i < threads; i++) {
+            handles[i] = platform_create_thread(run_worker, &pool.workers[i]);
+        }
+        run_worker(&pool.workers[0]);
+        for (int i = 1; i < threads; i++) {
+            if (handles[i] != NULL) {
+                platform_wait_thread(handles[i]);
+            }
+        }
+    }
+
+    for (int i = 0; i < threads; i++) {
+        if (pool.workers[i].mutex != NULL) {
+            platform_destroy_mutex(pool.workers[i].mutex);
+        }
+    }
+    free(pool.workers);
+    free(handles);
+    return ok;
+}
+
+static int run_worker(void *worker) {
+    struct worker *w = worker;
+    long task;
+    while (take_task(w, &task) || (steal_tasks(w) && take_task(w, &task))) {
+        w->pool->run(task, w->pool->data);
+    }
+    return 0;
+}
+
+static bool take_task(struct worker *worker, long *task) {
+    platform_lock_mutex(worker->mutex);
+    bool taken = worker->begin < worker->end;
+    if (taken) {
+        *task = worker->begin++;
+    }
+    platform_unlock_mutex(worker->mutex);
+    return taken;
+}
+
+// Move half of the tasks left to the first worker found with some into the
+// range of the given one, which must be empty. No tasks are ever added, so
+// there is nothing left to do once every other worker is found empty.
+static bool steal_tasks(struct worker *worker) {
+    struct pool *pool = worker->pool;
+    for (int i = 1; i < pool->workers_length; i++) {
+        struct worker *victim =
+            &pool->workers[(worker->no + i) % pool->workers_length];
+
+        platform_lock_mutex(victim->mutex);
+        long left = victim->end - victim->begin;
+        long begin = victim->end - ((left + 1) / 2);
+        long end = victim->end;
+        if (left > 0) {
+            victim->end = begin;
+        }
+        platform_unlock_mutex(victim->mutex);
+
+        if (left > 0) {
+            platform_lock_mutex(worker->mutex);
+            worker->begin = begin;
+            worker->end = end;
+            platform_unlock_mutex(worker->mutex);
+            return true;
+        }
+    }
+    return false;
+}
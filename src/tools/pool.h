@@ -0,0 +1,10 @@
+#pragma once
+#include <stdbool.h>
+
+// Run tasks numbered from 0 to count - 1 on a number of threads. Every thread
+// starts with an even share of the tasks and steals half of the tasks left to
+// another thread once it runs out, so threads that got slow tasks don't hold
+// up the others. The order the tasks are run in is unspecified, so a task
+// must only write to state of its own for the outcome to be deterministic.
+bool run_tasks(int threads, long count, void (*run)(long task, void *data),
+               void *data);
@@ -0,0 +1,458 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../digits.h"
+#include "../draw.h"
+#include "../raster.h"
+#include "../rewind.h"
+#include "../rollback.h"
+#include "../scene.h"
+#include "../sim.h"
+#include "../synth.h"
+#include "platform.h"
+
+#ifdef TENNIS_BENCH_SDL
+#define SDL_MAIN_HANDLED
+#include <SDL.h>
+
+#include "../renderer.h"
+#endif
+
+// Time the hot paths of the game with fixed inputs and seeds, and print the
+// results as JSON so that they can be compared between releases. The
+// benchmarks of the SDL software renderer are only built with SDL.
+
+#define DEFAULT_REPETITIONS 5
+#define TICK_DURATION (1.0 / 120.0)
+#define FRAME_DURATION (1.0 / 60.0)
+#define SAMPLE_RATE 44100
+
+struct benchmark {
+    const char *name;
+    const char *unit; // what an operation is
+    long iterations;  // operations per repetition, before scaling
+    // Run the operations and return a checksum of their results so that they
+    // can't be optimized away.
+    long (*run)(long iterations);
+};
+
+struct options {
+    int repetitions;
+    double scale; // of the number of iterations
+    const char *filter;
+};
+
+static void print_usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --repetitions N     times each benchmark is run, of which the "
+            "fastest and\n"
+            "                      the median are reported (default: 5)\n"
+            "  --scale X           multiply the iterations of every "
+            "benchmark by X\n"
+            "                      (default: 1)\n"
+            "  --filter TEXT       only run the benchmarks whose name "
+            "contains TEXT\n",
+            program);
+}
+
+static bool parse_options(int argc, char *argv[], struct options *options) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            return false;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", arg);
+            return false;
+        }
+        const char *value = argv[++i];
+        if (strcmp(arg, "--repetitions") == 0) {
+            options->repetitions = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--scale") == 0) {
+            options->scale = strtod(value, NULL);
+        } else if (strcmp(arg, "--filter") == 0) {
+            options->filter = value;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            return false;
+        }
+    }
+    return options->repetitions > 0 && options->scale > 0;
+}
+
+static long run_update_paddle(long iterations) {
+    struct paddle paddle = make_paddle(1);
+    paddle.velocity = paddle.max_speed;
+    for (long i = 0; i < iterations; i++) {
+        update_paddle(&paddle, TICK_DURATION);
+        // Back and forth between the walls.
+        if (paddle.rect.y <= 0.0f ||
+            paddle.rect.y >= LOGICAL_HEIGHT - paddle.rect.h) {
+            paddle.velocity = -paddle.velocity;
+        }
+    }
+    return paddle.rect.y;
+}
+
+// The paddles span the whole height so that the ball bounces between them
+// and off the walls forever.
+static long run_update_ball(long iterations) {
+    struct rng rng = make_rng(1);
+    struct paddle paddle_1 = make_paddle(1);
+    struct paddle paddle_2 = make_paddle(2);
+    paddle_1.rect.y = paddle_2.rect.y = 0.0f;
+    paddle_1.rect.h = paddle_2.rect.h = LOGICAL_HEIGHT;
+    struct ball ball = make_ball(&rng, 1, false, 0.0);
+    ball.served = true;
+
+    long contacts = 0;
+    for (long i = 0; i < iterations; i++) {
+        struct ball_contacts c =
+            update_ball(&ball, &paddle_1, &paddle_2, TICK_DURATION, 0.0);
+        contacts += c.wall + (c.paddle_no != 0);
+    }
+    return contacts;
+}
+
+static long run_set_ghost_velocity(long iterations) {
+    struct sim sim = make_sim(1);
+    sim.ball.served = true;
+    float velocity = 0.0f;
+    for (long i = 0; i < iterations; i++) {
+        sim.ball.rect.x = (i % LOGICAL_WIDTH);
+        set_ghost_velocity(&sim.ghost_1, sim.paddle_1, sim.ball,
+                           sim.prediction);
+        velocity += sim.ghost_1.velocity;
+    }
+    return velocity;
+}
+
+static long run_predict_ball(long iterations) {
+    struct sim sim = make_sim(1);
+    long checksum = 0;
+    for (long i = 0; i < iterations; i++) {
+        sim.ball.rect.y = (i % (LOGICAL_HEIGHT - BALL_SIZE));
+        struct ball_prediction prediction =
+            predict_ball(&sim.rng, sim.ball, sim.ghosts_sharpness, sim.time);
+        checksum += prediction.y;
+    }
+    return checksum;
+}
+
+// A tick of a sharp ghost against ghost match, restarted when it is over.
+static long run_tick(long iterations) {
+    struct sim sim = make_sim(1);
+    long checksum = 0;
+    for (long i = 0; i < iterations; i++) {
+        update_ghosts(&sim);
+        update_sim(&sim, TICK_DURATION);
+        sim.events = (struct sim_events){0};
+        if (sim.round_over) {
+            checksum += sim.paddle_1.score - sim.paddle_2.score;
+            sim = make_sim(i);
+        }
+    }
+    return checksum;
+}
+
+static long run_match(long iterations) {
+    long checksum = 0;
+    for (long i = 0; i < iterations; i++) {
+        struct sim sim = make_sim(i);
+        sim.ghosts_sharpness = 0.0f;
+        set_ghost_speed(&sim.ghost_1, sim.ghosts_sharpness);
+        set_ghost_speed(&sim.ghost_2, sim.ghosts_sharpness);
+        while (!sim.round_over) {
+            update_ghosts(&sim);
+            update_sim(&sim, TICK_DURATION);
+            sim.events = (struct sim_events){0};
+        }
+        checksum += sim.paddle_1.score - sim.paddle_2.score;
+    }
+    return checksum;
+}
+
+// Roll back the last 8 ticks of a netplay session at 240 Hz, as a late input
+// would, then simulate the next tick.
+static long run_rollback(long iterations) {
+    static struct rollback rollback;
+    init_rollback(&rollback, 1, 240, 1);
+    long checksum = 0;
+    for (long i = 0; i < iterations + 8; i++) {
+        if (rollback.tick >= 8) {
+            rollback.rollback_tick = rollback.tick - 8;
+            update_rollback(&rollback);
+        }
+        // The remote inputs are always received.
+        rollback.remote_ticks = rollback.tick + 1;
+        rollback.local_acked = rollback.tick;
+        step_rollback(&rollback, (i % 64 < 32) ? -500.0f : 500.0f);
+        checksum += rollback.sim.paddle_1.score;
+    }
+    return checksum;
+}
+
+// Keep the state of a tick in a rewind buffer of the default duration, which
+// is done on every tick.
+static long run_rewind_snapshot(long iterations) {
+    static struct rewind_buffer buffer;
+    if (!init_rewind_buffer(&buffer, REWIND_DURATION * 120)) {
+        return 0;
+    }
+    struct sim sim = make_sim(1);
+    for (long i = 0; i < iterations; i++) {
+        sim.time += TICK_DURATION;
+        push_rewind_snapshot(&buffer, &sim);
+    }
+    long checksum = get_rewind_snapshot(&buffer, buffer.ticks)->time;
+    destroy_rewind_buffer(&buffer);
+    return checksum;
+}
+
+// A second of audio with the three tones of the game overlapping, in periods
+// of 256 samples like the audio callback.
+static long run_audio_second(long iterations) {
+    static int16_t samples[256];
+    long checksum = 0;
+    struct mixer mixer = {0};
+    for (long i = 0; i < iterations; i++) {
+        start_voice(&mixer, 240, SAMPLE_RATE / 2, SAMPLE_RATE);
+        start_voice(&mixer, 480, SAMPLE_RATE / 30, SAMPLE_RATE);
+        start_voice(&mixer, 240, SAMPLE_RATE / 50, SAMPLE_RATE);
+        for (int j = 0; j < SAMPLE_RATE; j += 256) {
+            mix_voices(&mixer, INT16_MAX / 40, samples, 256);
+            checksum += samples[j / 256 % 256];
+        }
+    }
+    return checksum;
+}
+
+static struct draw_list list;
+
+static long run_render_digits(long iterations) {
+    long checksum = 0;
+    for (long i = 0; i < iterations; i++) {
+        clear_draw_list(&list, (struct color){0, 0, 0, 255});
+        render_digits(&list, (struct vec2){300.0f, 50.0f}, 80, i % 100);
+        checksum += list.rects_length;
+    }
+    return checksum;
+}
+
+static long run_render_net(long iterations) {
+    long checksum = 0;
+    for (long i = 0; i < iterations; i++) {
+        clear_draw_list(&list, (struct color){0, 0, 0, 255});
+        render_net(&list);
+        checksum += list.rects_length;
+    }
+    return checksum;
+}
+
+static long run_describe_frame(long iterations) {
+    struct sim sim = make_sim(1);
+    long checksum = 0;
+    for (long i = 0; i < iterations; i++) {
+        render_frame(&list, &sim);
+        checksum += list.rects_length;
+    }
+    return checksum;
+}
+
+// Rasterize a whole frame into a framebuffer of the given size.
+static long run_rasterize(long iterations, int width, int height,
+                          enum pixel_format format) {
+    struct framebuffer framebuffer = {
+        .width = width,
+        .height = height,
+        .pitch = width * get_pixel_size(format),
+        .format = format,
+    };
+    framebuffer.pixels = malloc((size_t)framebuffer.pitch * height);
+    if (framebuffer.pixels == NULL) {
+        return 0;
+    }
+    struct sim sim = make_sim(1);
+    render_frame(&list, &sim);
+    for (long i = 0; i < iterations; i++) {
+        rasterize_draw_list(&framebuffer, &list);
+    }
+    long checksum = framebuffer.pixels[framebuffer.pitch * height / 2];
+    free(framebuffer.pixels);
+    return checksum;
+}
+
+static long run_rasterize_small(long iterations) {
+    return run_rasterize(iterations, 84, 84, PIXEL_FORMAT_GRAY8);
+}
+
+static long run_rasterize_4k(long iterations) {
+    return run_rasterize(iterations, 3840, 2160, PIXEL_FORMAT_RGBA8888);
+}
+
+#ifdef TENNIS_BENCH_SDL
+static SDL_Surface *surface;
+static struct renderer_wrapper wrapper;
+
+static bool init_software_renderer(void) {
+    if (SDL_Init(0) < 0) {
+        fprintf(stderr, "Couldn't initialize SDL: %s\n", SDL_GetError());
+        return false;
+    }
+    surface = SDL_CreateRGBSurfaceWithFormat(0, 800, 600, 32,
+                                             SDL_PIXELFORMAT_RGBA8888);
+    SDL_Renderer *renderer =
+        surface != NULL ? SDL_CreateSoftwareRenderer(surface) : NULL;
+    if (renderer == NULL) {
+        fprintf(stderr, "Couldn't create a software renderer: %s\n",
+                SDL_GetError());
+        return false;
+    }
+    wrapper = make_renderer_wrapper(renderer, LOGICAL_WIDTH, LOGICAL_HEIGHT);
+    return true;
+}
+
+static void destroy_software_renderer(void) {
+    destroy_renderer_wrapper(&wrapper);
+    SDL_DestroyRenderer(wrapper.renderer);
+    SDL_FreeSurface(surface);
+    SDL_Quit();
+}
+
+// Draw the net and the scores, which the game caches, and everything else.
+static long run_software_render(long iterations) {
+    struct sim sim = make_sim(1);
+    render_frame(&list, &sim);
+    for (long i = 0; i < iterations; i++) {
+        renderer_wrapper_draw(&wrapper, &list);
+        SDL_RenderPresent(wrapper.renderer);
+    }
+    return ((uint32_t *)surface->pixels)[0];
+}
+
+// What a frame of the game at 60 Hz does besides polling events, with the
+// background cached like the game does.
+static long run_frame(long iterations) {
+    struct sim sim = make_sim(1);
+    static struct draw_list background;
+    clear_draw_list(&background, (struct color){0, 0, 0, 255});
+    set_draw_color(&background, (struct color){255, 255, 255, 255});
+    render_score(&background, sim.paddle_1);
+    render_score(&background, sim.paddle_2);
+    render_net(&background);
+    renderer_wrapper_set_background(&wrapper, &background);
+
+    for (long i = 0; i < iterations; i++) {
+        for (double t = 0.0; t < FRAME_DURATION; t += TICK_DURATION) {
+            update_ghosts(&sim);
+            update_sim(&sim, TICK_DURATION);
+            sim.events = (struct sim_events){0};
+        }
+        if (sim.round_over) {
+            sim = make_sim(i);
+        }
+        clear_draw_list(&list, (struct color){0, 0, 0, 255});
+        set_draw_color(&list, (struct color){255, 255, 255, 255});
+        render_paddle(&list, &sim, sim.paddle_1);
+        render_paddle(&list, &sim, sim.paddle_2);
+        render_ball(&list, sim.ball);
+        renderer_wrapper_draw(&wrapper, &list);
+        SDL_RenderPresent(wrapper.renderer);
+    }
+    return ((uint32_t *)surface->pixels)[0];
+}
+#endif
+
+static const struct benchmark BENCHMARKS[] = {
+    {"update_paddle", "tick", 10000000, run_update_paddle},
+    {"update_ball", "tick", 10000000, run_update_ball},
+    {"set_ghost_velocity", "call", 10000000, run_set_ghost_velocity},
+    {"predict_ball", "call", 1000000, run_predict_ball},
+    {"tick", "tick", 1000000, run_tick},
+    {"match", "match", 20, run_match},
+    {"rollback", "rollback of 8 ticks", 100000, run_rollback},
+    {"rewind_snapshot", "tick", 10000000, run_rewind_snapshot},
+    {"audio_second", "second of audio", 100, run_audio_second},
+    {"render_digits", "call", 1000000, run_render_digits},
+    {"render_net", "call", 1000000, run_render_net},
+    {"describe_frame", "frame", 1000000, run_describe_frame},
+    {"rasterize_small", "84x84 gray frame", 100000, run_rasterize_small},
+    {"rasterize_4k", "3840x2160 RGBA frame", 100, run_rasterize_4k},
+#ifdef TENNIS_BENCH_SDL
+    {"software_render", "frame", 1000, run_software_render},
+    {"frame", "frame", 1000, run_frame},
+#endif
+};
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void run_benchmark(struct options options,
+                          const struct benchmark *benchmark, bool first) {
+    long iterations = benchmark->iterations * options.scale;
+    if (iterations < 1) {
+        iterations = 1;
+    }
+
+    double times[64];
+    int repetitions = options.repetitions;
+    if (repetitions > 64) {
+        repetitions = 64;
+    }
+    long checksum = 0;
+    for (int i = 0; i < repetitions; i++) {
+        double start_time = platform_time();
+        checksum = benchmark->run(iterations);
+        times[i] = (platform_time() - start_time) / iterations;
+    }
+    qsort(times, repetitions, sizeof(double), compare_doubles);
+
+    printf("%s    {\"name\": \"%s\", \"unit\": \"%s\", \"iterations\": %ld, "
+           "\"repetitions\": %d, \"min_ns\": %.3f, \"median_ns\": %.3f, "
+           "\"per_sec\": %.1f, \"checksum\": %ld}",
+           first ? "" : ",\n", benchmark->name, benchmark->unit, iterations,
+           repetitions, times[0] * 1e9, times[repetitions / 2] * 1e9,
+           1.0 / times[0], checksum);
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    struct options options = {
+        .repetitions = DEFAULT_REPETITIONS,
+        .scale = 1.0,
+        .filter = "",
+    };
+    if (!parse_options(argc, argv, &options)) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+#ifdef TENNIS_BENCH_SDL
+    if (!init_software_renderer()) {
+        return EXIT_FAILURE;
+    }
+#endif
+
+    printf("{\n  \"benchmarks\": [\n");
+    bool first = true;
+    for (size_t i = 0; i < sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]); i++) {
+        if (strstr(BENCHMARKS[i].name, options.filter) == NULL) {
+            continue;
+        }
+        run_benchmark(options, &BENCHMARKS[i], first);
+        first = false;
+    }
+    printf("\n  ]\n}\n");
+
+#ifdef TENNIS_BENCH_SDL
+    destroy_software_renderer();
+#endif
+    return EXIT_SUCCESS;
+}
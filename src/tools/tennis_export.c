@@ -0,0 +1,288 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../draw.h"
+#include "../raster.h"
+#include "../record.h"
+#include "../scene.h"
+#include "../sim.h"
+#include "../synth.h"
+#include "export.h"
+#include "platform.h"
+
+// Export part of a recording made with the --record option of the game, or of
+// a ghost against ghost match, as a Y4M video and a WAV file with the sounds
+// of the game. Each frame is rendered headless with the software rasterizer
+// and handed over to a writer thread, with the samples played while it is
+// shown so that the audio stays aligned with the video to the sample.
+
+struct options {
+    const char *path; // of the recording, or NULL for a ghost match
+    const char *video_path;
+    const char *audio_path; // or NULL
+    int width;
+    int height;
+    int frame_rate; // in Hz
+    double from;    // in seconds
+    double to;      // in seconds, or negative for the end of the recording
+    int tick_rate;  // in Hz, of a ghost match
+    uint64_t seed;  // of a ghost match
+    float volume;   // in percent
+    int queue_length;
+};
+
+// Where the ticks come from.
+struct source {
+    struct replay replay;
+    bool recorded;
+    struct sim sim;
+    struct sim_events events; // of the last tick
+    int tick_rate;
+};
+
+static void print_usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options] [FILE]\n"
+            "  --video PATH        Y4M video to write, or - for standard "
+            "output\n"
+            "                      (default: export.y4m)\n"
+            "  --audio PATH        WAV audio to write alongside\n"
+            "  --size WxH          size of the frames (default: 800x600)\n"
+            "  --frame-rate HZ     frames per second (default: 60)\n"
+            "  --from SECONDS      start of the export (default: 0)\n"
+            "  --to SECONDS        end of the export (default: the end of "
+            "the\n"
+            "                      recording, or 60 for a ghost match)\n"
+            "  --tick-rate HZ      simulation ticks per second of a ghost "
+            "match\n"
+            "                      (default: 120)\n"
+            "  --seed N            seed of a ghost match (default: 1)\n"
+            "  --volume PERCENT    volume of the sounds (default: 2.5, like "
+            "the game)\n"
+            "  --queue N           frames waiting to be written at most "
+            "(default: 8)\n",
+            program);
+}
+
+static bool parse_options(int argc, char *argv[], struct options *options) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            return false;
+        }
+        if (arg[0] != '-' && options->path == NULL) {
+            options->path = arg;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", arg);
+            return false;
+        }
+        const char *value = argv[++i];
+        if (strcmp(arg, "--video") == 0) {
+            options->video_path = value;
+        } else if (strcmp(arg, "--audio") == 0) {
+            options->audio_path = value;
+        } else if (strcmp(arg, "--size") == 0) {
+            if (sscanf(value, "%dx%d", &options->width, &options->height) !=
+                2) {
+                return false;
+            }
+        } else if (strcmp(arg, "--frame-rate") == 0) {
+            options->frame_rate = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--from") == 0) {
+            options->from = strtod(value, NULL);
+        } else if (strcmp(arg, "--to") == 0) {
+            options->to = strtod(value, NULL);
+        } else if (strcmp(arg, "--tick-rate") == 0) {
+            options->tick_rate = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--seed") == 0) {
+            options->seed = strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--volume") == 0) {
+            options->volume = strtof(value, NULL);
+        } else if (strcmp(arg, "--queue") == 0) {
+            options->queue_length = strtol(value, NULL, 10);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            return false;
+        }
+    }
+    if (options->to < 0.0 && options->path == NULL) {
+        options->to = 60.0;
+    }
+    return options->width >= FRAMEBUFFER_MIN_SIZE &&
+           options->width <= FRAMEBUFFER_MAX_SIZE &&
+           options->height >= FRAMEBUFFER_MIN_SIZE &&
+           options->height <= FRAMEBUFFER_MAX_SIZE &&
+           options->frame_rate > 0 &&
+           options->frame_rate <= EXPORT_SAMPLE_RATE &&
+           options->from >= 0.0 &&
+           (options->to < 0.0 || options->to > options->from) &&
+           options->tick_rate > 0 && options->volume >= 0.0f &&
+           options->volume <= 100.0f && options->queue_length > 0;
+}
+
+static bool step_source(struct source *source) {
+    if (source->recorded) {
+        if (!step_replay(&source->replay)) {
+            return false;
+        }
+        source->sim = source->replay.sim;
+        source->events = source->replay.events;
+        return true;
+    }
+    update_ghosts(&source->sim);
+    update_sim(&source->sim, 1.0 / source->tick_rate);
+    source->events = source->sim.events;
+    source->sim.events = (struct sim_events){0};
+    return true;
+}
+
+static void start_tones(struct mixer *mixer, struct sim_events events) {
+    const struct game_tone *tones[3];
+    int length = 0;
+    if (events.paddle_missed_ball) {
+        tones[length++] = &PADDLE_MISSED_BALL_TONE;
+    }
+    if (events.ball_hit_paddle) {
+        tones[length++] = &BALL_HIT_PADDLE_TONE;
+    }
+    if (events.ball_hit_wall) {
+        tones[length++] = &BALL_HIT_WALL_TONE;
+    }
+    for (int i = 0; i < length; i++) {
+        start_voice(mixer, tones[i]->freq,
+                    tones[i]->duration_ms * EXPORT_SAMPLE_RATE / 1000,
+                    EXPORT_SAMPLE_RATE);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    struct options options = {
+        .video_path = "export.y4m",
+        .width = 800,
+        .height = 600,
+        .frame_rate = 60,
+        .to = -1.0,
+        .tick_rate = 120,
+        .seed = 1,
+        .volume = 2.5f,
+        .queue_length = 8,
+    };
+    if (!parse_options(argc, argv, &options)) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    static struct source source;
+    const void *data = NULL;
+    size_t size = 0;
+    if (options.path != NULL) {
+        data = platform_map_file(options.path, &size);
+        if (data == NULL || !open_replay(&source.replay, data, size)) {
+            fprintf(stderr, "Couldn't read recording %s\n", options.path);
+            return EXIT_FAILURE;
+        }
+        source.recorded = true;
+        source.tick_rate = source.replay.tick_rate;
+    } else {
+        source.sim = make_sim(options.seed);
+        source.tick_rate = options.tick_rate;
+    }
+
+    // The ticks and the samples are counted from the start of the export.
+    int64_t start_tick = options.from * source.tick_rate;
+    if (source.recorded) {
+        if (!seek_replay(&source.replay, start_tick)) {
+            fprintf(stderr, "The recording ends before %.3f s\n",
+                    options.from);
+            return EXIT_FAILURE;
+        }
+        source.sim = source.replay.sim;
+    } else {
+        for (int64_t i = 0; i < start_tick; i++) {
+            step_source(&source);
+        }
+    }
+    // A recording that was never closed doesn't know its length, and is
+    // exported until its stream ends.
+    int64_t frames = -1;
+    if (options.to >= 0.0) {
+        frames = (options.to - options.from) * options.frame_rate;
+    } else if (source.replay.ticks >= 0) {
+        frames = (source.replay.ticks - start_tick) * options.frame_rate /
+                 source.tick_rate;
+    }
+
+    struct exporter *exporter = open_exporter(
+        options.video_path, options.audio_path, options.width, options.height,
+        options.frame_rate, options.queue_length);
+    if (exporter == NULL) {
+        fprintf(stderr, "Couldn't open %s%s%s\n", options.video_path,
+                (options.audio_path != NULL) ? " or " : "",
+                (options.audio_path != NULL) ? options.audio_path : "");
+        return EXIT_FAILURE;
+    }
+
+    static struct draw_list list;
+    static struct mixer mixer;
+    float amplitude = options.volume / 100.0f * INT16_MAX;
+    int64_t ticks = 0;
+    int64_t samples = 0; // mixed so far
+    int64_t frame = 0;
+    bool ended = false;
+    double start_time = platform_time();
+    for (; frame != frames && !ended; frame++) {
+        struct export_frame *export_frame = begin_export_frame(exporter);
+        render_frame(&list, &source.sim);
+        rasterize_draw_list(&export_frame->framebuffer, &list);
+
+        // Simulate the ticks until the next frame, starting the tones of each
+        // on the sample at which the tick ends.
+        int64_t first_sample = frame * EXPORT_SAMPLE_RATE / options.frame_rate;
+        int64_t end_sample =
+            (frame + 1) * EXPORT_SAMPLE_RATE / options.frame_rate;
+        int64_t end_tick = (frame + 1) * source.tick_rate / options.frame_rate;
+        int16_t *frame_samples = export_frame->samples;
+        for (; ticks < end_tick; ticks++) {
+            if (!step_source(&source)) {
+                ended = true;
+                break;
+            }
+            int64_t tick_sample =
+                (ticks + 1) * EXPORT_SAMPLE_RATE / source.tick_rate;
+            mix_voices(&mixer, amplitude,
+                       frame_samples + (samples - first_sample),
+                       tick_sample - samples);
+            samples = tick_sample;
+            start_tones(&mixer, source.events);
+        }
+        mix_voices(&mixer, amplitude, frame_samples + (samples - first_sample),
+                   end_sample - samples);
+        samples = end_sample;
+        export_frame->samples_length = end_sample - first_sample;
+        end_export_frame(exporter);
+    }
+    long waits = get_export_waits(exporter);
+    bool ok = close_exporter(exporter);
+    double elapsed = platform_time() - start_time;
+    if (data != NULL) {
+        platform_unmap_file(data, size);
+    }
+
+    // The video may be on standard output.
+    double duration = frame / (double)options.frame_rate;
+    fprintf(stderr, "frames: %" PRId64 " (%.3f s)\n", frame, duration);
+    fprintf(stderr, "elapsed: %.3f s (%.1fx real time)\n", elapsed,
+            duration / elapsed);
+    fprintf(stderr, "waits for the writer: %ld\n", waits);
+    if (!ok) {
+        fprintf(stderr, "Couldn't write the export\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
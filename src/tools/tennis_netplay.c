@@ -0,0 +1,290 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../net.h"
+#include "../rollback.h"
+#include "../sim.h"
+#include "platform.h"
+
+// Play a netplay session headless against another instance of this tool,
+// usually over loopback with delayed and dropped packets, each peer moving its
+// paddle like a player with a keyboard would. Both peers print a hash of the
+// state at the last tick, which must be the same, and how much rolling back
+// cost.
+
+// How long to keep acknowledging the inputs of the other peer once done, in
+// case the last acknowledgements were lost.
+#define LINGER_DURATION 0.5 // in seconds
+#define TIMEOUT 10.0        // in seconds, without any packet
+
+struct options {
+    int player;
+    int port;
+    const char *peer;
+    long ticks;
+    int tick_rate;  // in Hz
+    int frame_rate; // in Hz
+    double delay;   // in seconds
+    float loss;     // from 0 to 1
+    uint64_t seed;
+};
+
+struct stats {
+    long frames;
+    long stalled_frames;
+    long packets_sent;
+    long packets_received;
+    double rollback_time;     // in seconds
+    double max_rollback_time; // in a frame, in seconds
+};
+
+static void print_usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s --netplay N --port PORT --peer HOST:PORT [options]\n"
+            "  --netplay N         1 or 2, the paddle of this peer, player 1 "
+            "picks the\n"
+            "                      seed\n"
+            "  --port PORT         UDP port to receive packets on\n"
+            "  --peer HOST:PORT    address of the other peer\n"
+            "  --ticks N           ticks to play (default: 2400)\n"
+            "  --tick-rate HZ      simulation ticks per second (default: "
+            "240)\n"
+            "  --frame-rate HZ     frames per second, in which packets are "
+            "exchanged\n"
+            "                      and rollbacks happen (default: 240)\n"
+            "  --net-delay MS      delay of the packets sent (default: 0)\n"
+            "  --net-loss PERCENT  share of the packets sent that are "
+            "dropped\n"
+            "                      (default: 0)\n"
+            "  --seed N            seed of the session (default: current "
+            "time)\n",
+            program);
+}
+
+static bool parse_options(int argc, char *argv[], struct options *options) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            return false;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", arg);
+            return false;
+        }
+        const char *value = argv[++i];
+        if (strcmp(arg, "--netplay") == 0) {
+            options->player = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--port") == 0) {
+            options->port = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--peer") == 0) {
+            options->peer = value;
+        } else if (strcmp(arg, "--ticks") == 0) {
+            options->ticks = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--tick-rate") == 0) {
+            options->tick_rate = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--frame-rate") == 0) {
+            options->frame_rate = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--net-delay") == 0) {
+            options->delay = strtod(value, NULL) / 1000.0;
+        } else if (strcmp(arg, "--net-loss") == 0) {
+            options->loss = strtof(value, NULL) / 100.0f;
+        } else if (strcmp(arg, "--seed") == 0) {
+            options->seed = strtoull(value, NULL, 10);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            return false;
+        }
+    }
+    return (options->player == 1 || options->player == 2) &&
+           options->port > 0 && options->peer != NULL && options->ticks > 0 &&
+           options->tick_rate > 0 && options->frame_rate > 0 &&
+           options->delay >= 0.0 && options->loss >= 0.0f &&
+           options->loss < 1.0f;
+}
+
+// Move the paddle the way the ghost would, but only at full speed or not at
+// all like with a keyboard, so that the inputs change now and then rather
+// than on every tick.
+static float get_bot_velocity(const struct sim *sim, int no) {
+    struct paddle paddle = (no == 1) ? sim->paddle_1 : sim->paddle_2;
+    struct ghost ghost = (no == 1) ? sim->ghost_1 : sim->ghost_2;
+    ghost.active = true;
+    set_ghost_velocity(&ghost, paddle, sim->ball, sim->prediction);
+    if (ghost.velocity > paddle.max_speed / 4.0f) {
+        return paddle.max_speed;
+    }
+    if (ghost.velocity < -paddle.max_speed / 4.0f) {
+        return -paddle.max_speed;
+    }
+    return 0.0f;
+}
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t length) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3; // FNV-1a
+    }
+    return hash;
+}
+
+// Hash the parts of the state that matter, leaving out the padding of the
+// structs.
+static uint64_t hash_sim(const struct sim *sim) {
+    uint64_t hash = 0xcbf29ce484222325;
+    hash = hash_bytes(hash, &sim->rng, sizeof(sim->rng));
+    hash = hash_bytes(hash, &sim->paddle_1.rect, sizeof(struct rect));
+    hash = hash_bytes(hash, &sim->paddle_2.rect, sizeof(struct rect));
+    hash = hash_bytes(hash, &sim->paddle_1.score, sizeof(int));
+    hash = hash_bytes(hash, &sim->paddle_2.score, sizeof(int));
+    hash = hash_bytes(hash, &sim->ball.rect, sizeof(struct rect));
+    hash = hash_bytes(hash, &sim->ball.velocity, sizeof(struct vec2));
+    hash = hash_bytes(hash, &sim->time, sizeof(double));
+    return hash;
+}
+
+static void report(struct options options, const struct rollback *rollback,
+                   const struct stats *stats, double elapsed) {
+    printf("player: %d\n", options.player);
+    printf("seed: %" PRIu64 "\n", rollback->seed);
+    printf("ticks: %" PRId64 "\n", rollback->tick);
+    printf("score: %d-%d\n", rollback->sim.paddle_1.score,
+           rollback->sim.paddle_2.score);
+    printf("state hash: %016" PRIx64 "\n", hash_sim(&rollback->sim));
+    printf("elapsed: %.3f s\n", elapsed);
+    printf("frames: %ld (%ld stalled waiting for the other peer)\n",
+           stats->frames, stats->stalled_frames);
+    printf("packets: %ld sent, %ld received\n", stats->packets_sent,
+           stats->packets_received);
+    printf("rollbacks: %ld\n", rollback->rollbacks);
+    if (rollback->rollbacks > 0) {
+        printf("ticks per rollback: %.1f (max %d)\n",
+               rollback->resimulated_ticks / (double)rollback->rollbacks,
+               rollback->max_rollback_ticks);
+        printf("resimulation per tick: %.3f us\n",
+               stats->rollback_time / rollback->resimulated_ticks * 1e6);
+        printf("max rollback in a frame: %.3f us\n",
+               stats->max_rollback_time * 1e6);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    struct options options = {
+        .ticks = 2400,
+        .tick_rate = 240,
+        .frame_rate = 240,
+        .seed = time(NULL),
+    };
+    if (!parse_options(argc, argv, &options)) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    struct net_link *link = open_net_link(options.port, options.peer,
+                                          options.delay, options.loss);
+    if (link == NULL) {
+        fprintf(stderr, "Couldn't open port %d to %s\n", options.port,
+                options.peer);
+        return EXIT_FAILURE;
+    }
+
+    // Player 2 waits for the first packet of player 1 to get the seed.
+    static struct rollback rollback;
+    bool started = options.player == 1;
+    if (started) {
+        init_rollback(&rollback, options.seed, options.tick_rate, 1);
+    }
+
+    struct stats stats = {0};
+    double tick_duration = 1.0 / options.tick_rate;
+    double frame_duration = 1.0 / options.frame_rate;
+    double start_time = platform_time();
+    double frame_time = start_time;
+    double last_receive_time = start_time;
+    double done_time = -1.0;
+    double accumulator = 0.0;
+
+    for (;;) {
+        double time = platform_time();
+        accumulator += time - frame_time;
+        frame_time = time;
+
+        uint8_t packet[NET_MAX_PACKET_LENGTH];
+        size_t length;
+        while ((length = receive_net_packet(link, packet, sizeof(packet),
+                                            time)) > 0) {
+            uint64_t seed;
+            int tick_rate;
+            if (!started &&
+                get_rollback_packet_session(packet, length, &seed,
+                                            &tick_rate)) {
+                init_rollback(&rollback, seed, tick_rate, 2);
+                started = true;
+                accumulator = 0.0;
+            }
+            if (started && read_rollback_packet(&rollback, packet, length)) {
+                stats.packets_received++;
+                last_receive_time = time;
+            }
+        }
+        if (time - last_receive_time > TIMEOUT) {
+            fprintf(stderr, "No packet from %s for %.0f s\n", options.peer,
+                    TIMEOUT);
+            close_net_link(link);
+            return EXIT_FAILURE;
+        }
+
+        if (started && rollback.rollback_tick >= 0) {
+            double rollback_start_time = platform_time();
+            update_rollback(&rollback);
+            double rollback_time = platform_time() - rollback_start_time;
+            stats.rollback_time += rollback_time;
+            if (rollback_time > stats.max_rollback_time) {
+                stats.max_rollback_time = rollback_time;
+            }
+        }
+
+        if (started) {
+
+            while (accumulator >= tick_duration &&
+                   rollback.tick < options.ticks) {
+                float velocity =
+                    get_bot_velocity(&rollback.sim, options.player);
+                if (!step_rollback(&rollback, velocity)) {
+                    accumulator = tick_duration;
+                    stats.stalled_frames++;
+                    break;
+                }
+                accumulator -= tick_duration;
+            }
+
+            length = write_rollback_packet(&rollback, packet);
+            send_net_packet(link, packet, length, time);
+            stats.packets_sent++;
+            stats.frames++;
+
+            // The state at the last tick can't change anymore once the
+            // inputs of both peers are known to both.
+            if (done_time < 0.0 && rollback.tick == options.ticks &&
+                rollback.remote_ticks >= options.ticks &&
+                rollback.local_acked == options.ticks) {
+                done_time = time;
+            }
+            if (done_time >= 0.0 && time - done_time > LINGER_DURATION) {
+                break;
+            }
+        }
+
+        double sleep_duration = frame_time + frame_duration - platform_time();
+        if (sleep_duration > 0.0) {
+            platform_sleep(sleep_duration);
+        }
+    }
+
+    report(options, &rollback, &stats, platform_time() - start_time);
+    close_net_link(link);
+    return EXIT_SUCCESS;
+}
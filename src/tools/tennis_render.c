@@ -0,0 +1,200 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../draw.h"
+#include "../raster.h"
+#include "../scene.h"
+#include "../sim.h"
+#include "platform.h"
+
+// Render the frames of ghost against ghost matches headless with the software
+// rasterizer, and print a hash of all their pixels along with how fast they
+// were drawn. The matches only depend on the seed, so the hash of a given size
+// and format only changes when the drawing of the game does, which --expect
+// checks.
+
+struct options {
+    int width;
+    int height;
+    enum pixel_format format;
+    long frames;
+    int tick_rate;  // in Hz
+    int frame_rate; // in Hz
+    uint64_t seed;
+    const char *expected_hash; // or NULL
+    const char *output_path;   // or NULL
+};
+
+static void print_usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --size WxH          size of the frames, from %dx%d up to "
+            "%dx%d\n"
+            "                      (default: 84x84)\n"
+            "  --format FORMAT     gray or rgba (default: gray)\n"
+            "  --frames N          frames to render (default: 10000)\n"
+            "  --tick-rate HZ      simulation ticks per second (default: "
+            "120)\n"
+            "  --frame-rate HZ     frames per second of the matches "
+            "(default: 60)\n"
+            "  --seed N            seed of the first match (default: 1)\n"
+            "  --expect HASH       fail unless the frames hash to HASH\n"
+            "  --output PATH       write the last frame as a PGM or PAM "
+            "image\n",
+            program, FRAMEBUFFER_MIN_SIZE, FRAMEBUFFER_MIN_SIZE,
+            FRAMEBUFFER_MAX_SIZE, FRAMEBUFFER_MAX_SIZE);
+}
+
+static bool parse_options(int argc, char *argv[], struct options *options) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            return false;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", arg);
+            return false;
+        }
+        const char *value = argv[++i];
+        if (strcmp(arg, "--size") == 0) {
+            if (sscanf(value, "%dx%d", &options->width, &options->height) !=
+                2) {
+                return false;
+            }
+        } else if (strcmp(arg, "--format") == 0) {
+            if (strcmp(value, "gray") == 0) {
+                options->format = PIXEL_FORMAT_GRAY8;
+            } else if (strcmp(value, "rgba") == 0) {
+                options->format = PIXEL_FORMAT_RGBA8888;
+            } else {
+                fprintf(stderr, "Unknown format: %s\n", value);
+                return false;
+            }
+        } else if (strcmp(arg, "--frames") == 0) {
+            options->frames = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--tick-rate") == 0) {
+            options->tick_rate = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--frame-rate") == 0) {
+            options->frame_rate = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--seed") == 0) {
+            options->seed = strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--expect") == 0) {
+            options->expected_hash = value;
+        } else if (strcmp(arg, "--output") == 0) {
+            options->output_path = value;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            return false;
+        }
+    }
+    return options->width >= FRAMEBUFFER_MIN_SIZE &&
+           options->width <= FRAMEBUFFER_MAX_SIZE &&
+           options->height >= FRAMEBUFFER_MIN_SIZE &&
+           options->height <= FRAMEBUFFER_MAX_SIZE && options->frames > 0 &&
+           options->tick_rate > 0 && options->frame_rate > 0;
+}
+
+// Write a frame as a binary PGM when it is gray, or as a PAM with alpha.
+static bool write_frame(const char *path,
+                        const struct framebuffer *framebuffer) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        return false;
+    }
+    if (framebuffer->format == PIXEL_FORMAT_GRAY8) {
+        fprintf(file, "P5\n%d %d\n255\n", framebuffer->width,
+                framebuffer->height);
+    } else {
+        fprintf(file,
+                "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 4\nMAXVAL 255\n"
+                "TUPLTYPE RGB_ALPHA\nENDHDR\n",
+                framebuffer->width, framebuffer->height);
+    }
+    size_t row_length =
+        framebuffer->width * get_pixel_size(framebuffer->format);
+    for (int y = 0; y < framebuffer->height; y++) {
+        fwrite(framebuffer->pixels + (size_t)y * framebuffer->pitch, 1,
+               row_length, file);
+    }
+    return fclose(file) == 0;
+}
+
+int main(int argc, char *argv[]) {
+    struct options options = {
+        .width = 84,
+        .height = 84,
+        .format = PIXEL_FORMAT_GRAY8,
+        .frames = 10000,
+        .tick_rate = 120,
+        .frame_rate = 60,
+        .seed = 1,
+    };
+    if (!parse_options(argc, argv, &options)) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    struct framebuffer framebuffer = {
+        .width = options.width,
+        .height = options.height,
+        .pitch = options.width * get_pixel_size(options.format),
+        .format = options.format,
+    };
+    framebuffer.pixels = malloc((size_t)framebuffer.pitch * options.height);
+    if (framebuffer.pixels == NULL) {
+        fprintf(stderr, "Couldn't allocate the framebuffer\n");
+        return EXIT_FAILURE;
+    }
+
+    static struct draw_list list;
+    struct sim sim = make_sim(options.seed);
+    long matches = 1;
+    double tick_duration = 1.0 / options.tick_rate;
+    double raster_time = 0.0;
+    uint64_t hash = 0xcbf29ce484222325;
+    for (long frame = 0; frame < options.frames; frame++) {
+        // Tick as many times as the game would have by the end of the frame.
+        long ticks = (frame + 1) * options.tick_rate / options.frame_rate -
+                     frame * options.tick_rate / options.frame_rate;
+        for (long i = 0; i < ticks; i++) {
+            update_ghosts(&sim);
+            update_sim(&sim, tick_duration);
+            sim.events = (struct sim_events){0};
+        }
+        if (sim.round_over) {
+            sim = make_sim(options.seed + matches++);
+        }
+
+        render_frame(&list, &sim);
+        double start_time = platform_time();
+        rasterize_draw_list(&framebuffer, &list);
+        raster_time += platform_time() - start_time;
+        hash = (hash ^ hash_framebuffer(&framebuffer)) * 0x100000001b3;
+    }
+
+    printf("size: %dx%d\n", options.width, options.height);
+    printf("format: %s\n",
+           (options.format == PIXEL_FORMAT_GRAY8) ? "gray" : "rgba");
+    printf("frames: %ld\n", options.frames);
+    printf("hash: %016" PRIx64 "\n", hash);
+    printf("rasterization: %.3f us per frame (%.0f frames per second)\n",
+           raster_time / options.frames * 1e6, options.frames / raster_time);
+
+    bool ok = true;
+    if (options.output_path != NULL &&
+        !write_frame(options.output_path, &framebuffer)) {
+        fprintf(stderr, "Couldn't write %s\n", options.output_path);
+        ok = false;
+    }
+    if (options.expected_hash != NULL &&
+        strtoull(options.expected_hash, NULL, 16) != hash) {
+        fprintf(stderr, "The frames don't hash to %s\n",
+                options.expected_hash);
+        ok = false;
+    }
+    free(framebuffer.pixels);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,155 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../record.h"
+#include "../sim.h"
+#include "platform.h"
+
+// Play a recording of a match made with the --record option of the game,
+// seeking to a moment of it to report the state of the match there.
+
+struct options {
+    const char *path;
+    double time; // to seek to, in seconds, or negative for the end
+    bool verify;
+};
+
+static void print_usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options] FILE\n"
+            "  --at SECONDS   seek to the given time of the match (default: "
+            "its end)\n"
+            "  --verify       play the whole recording and check that the "
+            "state\n"
+            "                 matches every keyframe\n",
+            program);
+}
+
+static bool parse_options(int argc, char *argv[], struct options *options) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            return false;
+        }
+        if (strcmp(arg, "--verify") == 0) {
+            options->verify = true;
+        } else if (strcmp(arg, "--at") == 0 && i + 1 < argc) {
+            options->time = strtod(argv[++i], NULL);
+            if (options->time < 0) {
+                return false;
+            }
+        } else if (arg[0] != '-' && options->path == NULL) {
+            options->path = arg;
+        } else {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", arg);
+            return false;
+        }
+    }
+    return options->path != NULL;
+}
+
+static void print_state(const struct replay *replay) {
+    const struct sim *sim = &replay->sim;
+    printf("tick: %" PRId64 "\n", replay->tick);
+    printf("time: %.3f s\n", replay->tick / (double)replay->tick_rate);
+    printf("score: %d-%d%s\n", sim->paddle_1.score, sim->paddle_2.score,
+           sim->round_over ? " (round over)" : "");
+    printf("ball: %.1f, %.1f\n", sim->ball.rect.x, sim->ball.rect.y);
+    printf("paddles: %.1f, %.1f\n", sim->paddle_1.rect.y,
+           sim->paddle_2.rect.y);
+    printf("ghosts active: %d, %d\n", sim->ghost_1.active, sim->ghost_2.active);
+}
+
+// Play the recording from its start and return the number of keyframes whose
+// state isn't the one played.
+static long verify(struct replay *replay) {
+    seek_replay(replay, 0);
+    long mismatches = 0;
+    for (size_t i = 0; i < replay->keyframes_length; i++) {
+        struct keyframe keyframe = get_replay_keyframe(replay, i);
+        // Seeking would restore the keyframe.
+        while (replay->tick < keyframe.tick) {
+            if (!step_replay(replay)) {
+                fprintf(stderr, "The stream ends before keyframe %zu\n", i);
+                return mismatches + replay->keyframes_length - i;
+            }
+        }
+        // The events are only cleared by the game once a frame.
+        keyframe.sim.events = replay->sim.events;
+        if (!is_same_recorded_state(&keyframe.sim, &replay->sim)) {
+            if (mismatches == 0) {
+                fprintf(stderr, "The state differs at tick %" PRId64 "\n",
+                        keyframe.tick);
+            }
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+int main(int argc, char *argv[]) {
+    struct options options = {.time = -1.0};
+    if (!parse_options(argc, argv, &options)) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    size_t size;
+    const void *data = platform_map_file(options.path, &size);
+    if (data == NULL) {
+        fprintf(stderr, "Couldn't map %s\n", options.path);
+        return EXIT_FAILURE;
+    }
+    struct replay replay;
+    if (!open_replay(&replay, data, size)) {
+        fprintf(stderr, "%s isn't a recording this build can play\n",
+                options.path);
+        platform_unmap_file(data, size);
+        return EXIT_FAILURE;
+    }
+
+    printf("seed: %" PRIu64 "\n", replay.seed);
+    printf("tick rate: %d Hz\n", replay.tick_rate);
+    if (replay.ticks >= 0) {
+        double duration = replay.ticks / (double)replay.tick_rate;
+        printf("duration: %.1f s\n", duration);
+        printf("size: %zu bytes (%.1f bytes/s)\n", size,
+               duration > 0 ? size / duration : 0.0);
+    } else {
+        printf("duration: unknown, the recording wasn't closed\n");
+        printf("size: %zu bytes\n", size);
+    }
+    printf("keyframes: %zu\n", replay.keyframes_length);
+
+    int status = EXIT_SUCCESS;
+    if (options.verify) {
+        double start_time = platform_time();
+        long mismatches = verify(&replay);
+        printf("verified in: %.3f s\n", platform_time() - start_time);
+        printf("mismatched keyframes: %ld\n", mismatches);
+        if (mismatches > 0) {
+            status = EXIT_FAILURE;
+        }
+    }
+
+    // Without an index, the end is wherever the stream stops.
+    int64_t tick = (options.time >= 0)
+                       ? (int64_t)(options.time * replay.tick_rate + 0.5)
+                       : (replay.ticks >= 0 ? replay.ticks : INT64_MAX);
+    double start_time = platform_time();
+    bool reached = seek_replay(&replay, tick);
+    double elapsed = platform_time() - start_time;
+    printf("\n");
+    if (!reached && (options.time >= 0 || replay.ticks >= 0)) {
+        fprintf(stderr, "The recording ends before tick %" PRId64 "\n", tick);
+        status = EXIT_FAILURE;
+    }
+    print_state(&replay);
+    printf("seeked in: %.6f s\n", elapsed);
+
+    platform_unmap_file(data, size);
+    return status;
+}
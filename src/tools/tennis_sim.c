@@ -0,0 +1,327 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../batch.h"
+#include "../sim.h"
+#include "platform.h"
+
+// Play ghost against ghost matches headless as fast as possible and report
+// the throughput of the simulation.
+
+struct options {
+    long matches;
+    float sharpness;
+    int max_score;
+    int tick_rate;  // in Hz
+    long max_ticks; // per match
+    uint64_t seed;
+    int lanes; // of the batch engine, or 0 to play one match at a time
+    bool compare;
+};
+
+struct match_result {
+    int score_1;
+    int score_2;
+    long ticks;
+    bool finished;
+};
+
+static void print_usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -n, --matches N     number of matches to play (default: 1000)\n"
+            "  --sharpness X       ghosts sharpness from 0 to 1 (default: 1)\n"
+            "  --max-score N       score that ends a match (default: 11)\n"
+            "  --tick-rate HZ      simulation ticks per second (default: "
+            "120)\n"
+            "  --max-ticks N       give up on a match after N ticks "
+            "(default: 10000000)\n"
+            "  --seed N            seed of the first match, the following "
+            "matches\n"
+            "                      are seeded with N + 1, N + 2... "
+            "(default: current\n"
+            "                      time)\n"
+            "  --lanes N           play N matches at once with the SIMD batch "
+            "engine\n"
+            "  --compare           play the matches with both engines, check "
+            "that\n"
+            "                      their results are identical and compare "
+            "their speed\n",
+            program);
+}
+
+static bool parse_options(int argc, char *argv[], struct options *options) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            return false;
+        }
+        if (strcmp(arg, "--compare") == 0) {
+            options->compare = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", arg);
+            return false;
+        }
+        const char *value = argv[++i];
+        if (strcmp(arg, "-n") == 0 || strcmp(arg, "--matches") == 0) {
+            options->matches = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--sharpness") == 0) {
+            options->sharpness = strtof(value, NULL);
+        } else if (strcmp(arg, "--max-score") == 0) {
+            options->max_score = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--tick-rate") == 0) {
+            options->tick_rate = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--max-ticks") == 0) {
+            options->max_ticks = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--seed") == 0) {
+            options->seed = strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--lanes") == 0) {
+            options->lanes = strtol(value, NULL, 10);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            return false;
+        }
+    }
+    if (options->compare && options->lanes == 0) {
+        options->lanes = 1024;
+    }
+    return options->matches > 0 && options->max_score > 0 &&
+           options->tick_rate > 0 && options->max_ticks > 0 &&
+           options->lanes >= 0;
+}
+
+// Every match gets its own seed so any of them can be replayed alone.
+static struct sim make_match(struct options options, long match) {
+    struct sim sim = make_sim(options.seed + match);
+    sim.max_score = options.max_score;
+    sim.ghosts_sharpness = options.sharpness;
+    set_ghost_speed(&sim.ghost_1, sim.ghosts_sharpness);
+    set_ghost_speed(&sim.ghost_2, sim.ghosts_sharpness);
+    // The first serve was predicted with the default sharpness.
+    sim.prediction =
+        predict_ball(&sim.rng, sim.ball, sim.ghosts_sharpness, sim.time);
+    return sim;
+}
+
+static struct match_result play_match(struct options options, long match) {
+    struct sim sim = make_match(options, match);
+
+    double tick_duration = 1.0 / options.tick_rate;
+    long ticks = 0;
+    while (!sim.round_over && ticks < options.max_ticks) {
+        update_ghosts(&sim);
+        update_sim(&sim, tick_duration);
+        sim.events = (struct sim_events){0};
+        ticks++;
+    }
+
+    return (struct match_result){
+        .score_1 = sim.paddle_1.score,
+        .score_2 = sim.paddle_2.score,
+        .ticks = ticks,
+        .finished = sim.round_over,
+    };
+}
+
+static void play_matches(struct options options,
+                         struct match_result *results) {
+    for (long i = 0; i < options.matches; i++) {
+        results[i] = play_match(options, i);
+    }
+}
+
+static struct match_result make_batch_result(const struct sim_batch *batch,
+                                             int lane, bool finished) {
+    struct sim sim = get_sim_batch_lane(batch, lane);
+    return (struct match_result){
+        .score_1 = sim.paddle_1.score,
+        .score_2 = sim.paddle_2.score,
+        .ticks = get_sim_batch_lane_ticks(batch, lane),
+        .finished = finished,
+    };
+}
+
+// Play the matches on the lanes of a batch, starting the next match on a lane
+// as soon as the one on it is over.
+static bool play_batched_matches(struct options options,
+                                 struct match_result *results) {
+    struct sim_batch batch;
+    if (!init_sim_batch(&batch, options.lanes, 1.0 / options.tick_rate)) {
+        fprintf(stderr, "Couldn't allocate a batch of %d lanes\n",
+                options.lanes);
+        return false;
+    }
+    long *lane_matches = malloc(options.lanes * sizeof(long));
+    if (lane_matches == NULL) {
+        destroy_sim_batch(&batch);
+        return false;
+    }
+
+    long next_match = 0;
+    int busy_lanes = 0;
+    for (int lane = 0; lane < options.lanes && next_match < options.matches;
+         lane++) {
+        struct sim sim = make_match(options, next_match);
+        set_sim_batch_lane(&batch, lane, &sim);
+        lane_matches[lane] = next_match++;
+        busy_lanes++;
+    }
+
+    for (long tick = 1; busy_lanes > 0; tick++) {
+        update_sim_batch(&batch);
+
+        for (int i = 0; i < batch.finished_lanes_length; i++) {
+            int lane = batch.finished_lanes[i];
+            results[lane_matches[lane]] =
+                make_batch_result(&batch, lane, true);
+            if (next_match < options.matches) {
+                struct sim sim = make_match(options, next_match);
+                set_sim_batch_lane(&batch, lane, &sim);
+                lane_matches[lane] = next_match++;
+            } else {
+                busy_lanes--;
+            }
+        }
+
+        // A match can't have gone on for too long before the first lane
+        // could, and scanning every lane for it now and then is enough since
+        // it is so unlikely.
+        if (tick >= options.max_ticks && tick % 1024 == 0) {
+            for (int lane = 0; lane < options.lanes; lane++) {
+                if (batch.active[lane] &&
+                    batch.ticks[lane] >= options.max_ticks) {
+                    results[lane_matches[lane]] =
+                        make_batch_result(&batch, lane, false);
+                    clear_sim_batch_lane(&batch, lane);
+                    busy_lanes--;
+                }
+            }
+        }
+    }
+
+    free(lane_matches);
+    destroy_sim_batch(&batch);
+    return true;
+}
+
+static double report(struct options options, const char *engine,
+                     const struct match_result *results, double elapsed) {
+    long unfinished_matches = 0;
+    long long ticks = 0;
+    long points = 0;
+    for (long i = 0; i < options.matches; i++) {
+        unfinished_matches += !results[i].finished;
+        ticks += results[i].ticks;
+        points += results[i].score_1 + results[i].score_2;
+    }
+
+    printf("engine: %s\n", engine);
+    printf("seed: %" PRIu64 "\n", options.seed);
+    printf("matches: %ld (%ld unfinished)\n", options.matches,
+           unfinished_matches);
+    printf("ticks: %lld\n", ticks);
+    printf("simulated time: %.1f s\n", ticks / (double)options.tick_rate);
+    printf("points per match: %.2f\n", points / (double)options.matches);
+    printf("elapsed: %.3f s\n", elapsed);
+    printf("matches/sec: %.1f\n", options.matches / elapsed);
+    printf("ticks/sec: %.0f\n", ticks / elapsed);
+    return ticks / elapsed;
+}
+
+// Return the number of finished matches whose results differ. Unfinished
+// matches may have been given up on a few ticks apart.
+static long count_mismatches(struct options options,
+                             const struct match_result *a,
+                             const struct match_result *b) {
+    long mismatches = 0;
+    for (long i = 0; i < options.matches; i++) {
+        if (a[i].finished != b[i].finished ||
+            (a[i].finished &&
+             (a[i].score_1 != b[i].score_1 || a[i].score_2 != b[i].score_2 ||
+              a[i].ticks != b[i].ticks))) {
+            if (mismatches == 0) {
+                fprintf(stderr,
+                        "Match %ld (seed %" PRIu64 ") differs: %d-%d in %ld "
+                        "ticks against %d-%d in %ld ticks\n",
+                        i, options.seed + i, a[i].score_1, a[i].score_2,
+                        a[i].ticks, b[i].score_1, b[i].score_2, b[i].ticks);
+            }
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+int main(int argc, char *argv[]) {
+    struct options options = {
+        .matches = 1000,
+        .sharpness = 1.0f,
+        .max_score = 11,
+        .tick_rate = 120,
+        .max_ticks = 10000000,
+        .seed = time(NULL),
+    };
+    if (!parse_options(argc, argv, &options)) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    struct match_result *results =
+        calloc(options.matches, sizeof(struct match_result));
+    struct match_result *batch_results =
+        calloc(options.matches, sizeof(struct match_result));
+    if (results == NULL || batch_results == NULL) {
+        fprintf(stderr, "Couldn't allocate the results of %ld matches\n",
+                options.matches);
+        return EXIT_FAILURE;
+    }
+
+    char batch_engine[64];
+    snprintf(batch_engine, sizeof(batch_engine),
+             "batch (%d lanes, %d per instruction)", options.lanes,
+             get_sim_batch_width());
+
+    int status = EXIT_SUCCESS;
+    if (options.lanes == 0 || options.compare) {
+        double start_time = platform_time();
+        play_matches(options, results);
+        double ticks_per_sec =
+            report(options, "scalar", results, platform_time() - start_time);
+
+        if (options.compare) {
+            printf("\n");
+            start_time = platform_time();
+            if (!play_batched_matches(options, batch_results)) {
+                return EXIT_FAILURE;
+            }
+            double batch_ticks_per_sec =
+                report(options, batch_engine, batch_results,
+                       platform_time() - start_time);
+
+            long mismatches =
+                count_mismatches(options, results, batch_results);
+            printf("\nspeedup: %.1fx\n", batch_ticks_per_sec / ticks_per_sec);
+            printf("mismatched matches: %ld\n", mismatches);
+            if (mismatches > 0) {
+                status = EXIT_FAILURE;
+            }
+        }
+    } else {
+        double start_time = platform_time();
+        if (!play_batched_matches(options, batch_results)) {
+            return EXIT_FAILURE;
+        }
+        report(options, batch_engine, batch_results,
+               platform_time() - start_time);
+    }
+
+    free(results);
+    free(batch_results);
+    return status;
+}
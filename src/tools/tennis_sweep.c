@@ -0,0 +1,376 @@
+#include <inttypes.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../sim.h"
+#include "platform.h"
+#include "pool.h"
+
+// Play ghost against ghost matches for every combination of a grid of ghost
+// parameters on all the processors of the machine and report how each
+// combination plays. The report only depends on the options and not on the
+// number of threads the matches are played on.
+
+#define MAX_VALUES 32
+
+// How many matches of a combination a task plays, which is small enough for
+// the tasks to balance well and large enough for their overhead to vanish.
+#define MATCHES_PER_TASK 16
+
+struct values {
+    float values[MAX_VALUES];
+    int length;
+};
+
+struct options {
+    long matches; // per combination
+    int max_score;
+    int tick_rate;  // in Hz
+    long max_ticks; // per match
+    uint64_t seed;
+    int threads;
+    struct values sharpness;
+    struct values speed_1;
+    struct values speed_2;
+    struct values bias_1;
+    struct values bias_2;
+    struct values idle_offset_1;
+    struct values idle_offset_2;
+};
+
+struct combination {
+    float sharpness;
+    float speed_1;
+    float speed_2;
+    float bias_1;
+    float bias_2;
+    int idle_offset_1;
+    int idle_offset_2;
+};
+
+struct stats {
+    long matches;
+    long wins_1;
+    long unfinished;
+    long points;
+    long hits;
+    long long ticks;
+    double ball_speed_sum; // right after every hit
+    float max_ball_speed;
+};
+
+struct sweep {
+    const struct options *options;
+    long combinations_length;
+    long tasks_per_combination;
+    struct stats *task_stats;
+};
+
+static void print_usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -n, --matches N        matches per combination (default: "
+            "1000)\n"
+            "  --max-score N          score that ends a match (default: 11)\n"
+            "  --tick-rate HZ         simulation ticks per second (default: "
+            "120)\n"
+            "  --max-ticks N          give up on a match after N ticks "
+            "(default: 10000000)\n"
+            "  --seed N               seed of the first match of every "
+            "combination, the\n"
+            "                         following ones are seeded with N + 1, "
+            "N + 2...\n"
+            "                         (default: current time)\n"
+            "  --threads N            (default: number of processors)\n"
+            "\n"
+            "Every parameter takes a comma separated list of values to "
+            "sweep:\n"
+            "  --sharpness X,...      ghosts sharpness (default: 1)\n"
+            "  --speed-1 X,...        sharpness the speed of ghost 1 is set "
+            "from\n"
+            "                         (default: 1)\n"
+            "  --speed-2 X,...        same for ghost 2\n"
+            "  --bias-1 X,...         range of the bias of ghost 1 from 0 to 1 "
+            "(default: 1)\n"
+            "  --bias-2 X,...         same for ghost 2\n"
+            "  --idle-offset-1 N,...  range of the idle offset of ghost 1 "
+            "(default: 75)\n"
+            "  --idle-offset-2 N,...  same for ghost 2\n",
+            program);
+}
+
+static bool parse_values(const char *arg, struct values *values) {
+    values->length = 0;
+    const char *s = arg;
+    while (values->length < MAX_VALUES) {
+        char *end;
+        values->values[values->length++] = strtof(s, &end);
+        if (end == s) {
+            return false;
+        }
+        if (*end == '\0') {
+            return true;
+        }
+        if (*end != ',') {
+            return false;
+        }
+        s = end + 1;
+    }
+    return false;
+}
+
+static bool parse_options(int argc, char *argv[], struct options *options) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            return false;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", arg);
+            return false;
+        }
+        const char *value = argv[++i];
+        struct values *values = NULL;
+        if (strcmp(arg, "-n") == 0 || strcmp(arg, "--matches") == 0) {
+            options->matches = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--max-score") == 0) {
+            options->max_score = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--tick-rate") == 0) {
+            options->tick_rate = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--max-ticks") == 0) {
+            options->max_ticks = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--seed") == 0) {
+            options->seed = strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--threads") == 0) {
+            options->threads = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--sharpness") == 0) {
+            values = &options->sharpness;
+        } else if (strcmp(arg, "--speed-1") == 0) {
+            values = &options->speed_1;
+        } else if (strcmp(arg, "--speed-2") == 0) {
+            values = &options->speed_2;
+        } else if (strcmp(arg, "--bias-1") == 0) {
+            values = &options->bias_1;
+        } else if (strcmp(arg, "--bias-2") == 0) {
+            values = &options->bias_2;
+        } else if (strcmp(arg, "--idle-offset-1") == 0) {
+            values = &options->idle_offset_1;
+        } else if (strcmp(arg, "--idle-offset-2") == 0) {
+            values = &options->idle_offset_2;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            return false;
+        }
+        if (values != NULL && !parse_values(value, values)) {
+            fprintf(stderr, "Invalid list of at most %d values: %s\n",
+                    MAX_VALUES, value);
+            return false;
+        }
+    }
+    return options->matches > 0 && options->max_score > 0 &&
+           options->tick_rate > 0 && options->max_ticks > 0 &&
+           options->threads > 0;
+}
+
+static long count_combinations(const struct options *options) {
+    return (long)options->sharpness.length * options->speed_1.length *
+           options->speed_2.length * options->bias_1.length *
+           options->bias_2.length * options->idle_offset_1.length *
+           options->idle_offset_2.length;
+}
+
+// Return the combination of the given index, the last parameter varying the
+// fastest.
+static struct combination get_combination(const struct options *options,
+                                          long index) {
+    struct combination c;
+    c.idle_offset_2 =
+        options->idle_offset_2.values[index % options->idle_offset_2.length];
+    index /= options->idle_offset_2.length;
+    c.idle_offset_1 =
+        options->idle_offset_1.values[index % options->idle_offset_1.length];
+    index /= options->idle_offset_1.length;
+    c.bias_2 = options->bias_2.values[index % options->bias_2.length];
+    index /= options->bias_2.length;
+    c.bias_1 = options->bias_1.values[index % options->bias_1.length];
+    index /= options->bias_1.length;
+    c.speed_2 = options->speed_2.values[index % options->speed_2.length];
+    index /= options->speed_2.length;
+    c.speed_1 = options->speed_1.values[index % options->speed_1.length];
+    index /= options->speed_1.length;
+    c.sharpness = options->sharpness.values[index];
+    return c;
+}
+
+// Every match gets a seed of its own that is the same for every combination,
+// so that combinations are compared on the same serves.
+static struct sim make_match(const struct options *options,
+                             struct combination c, long match) {
+    struct sim sim = make_sim(options->seed + match);
+    sim.max_score = options->max_score;
+    sim.ghosts_sharpness = c.sharpness;
+    // The first serve was predicted with the default sharpness.
+    sim.prediction =
+        predict_ball(&sim.rng, sim.ball, sim.ghosts_sharpness, sim.time);
+    set_ghost_speed(&sim.ghost_1, c.speed_1);
+    set_ghost_speed(&sim.ghost_2, c.speed_2);
+    sim.ghost_1.max_bias = c.bias_1;
+    sim.ghost_2.max_bias = c.bias_2;
+    set_ghost_bias(&sim.ghost_1, &sim.rng);
+    set_ghost_bias(&sim.ghost_2, &sim.rng);
+    sim.ghost_1.max_idle_offset = c.idle_offset_1;
+    sim.ghost_2.max_idle_offset = c.idle_offset_2;
+    return sim;
+}
+
+static void play_match(const struct options *options, struct sim *sim,
+                       struct stats *stats) {
+    double tick_duration = 1.0 / options->tick_rate;
+    long ticks = 0;
+    while (!sim->round_over && ticks < options->max_ticks) {
+        update_ghosts(sim);
+        update_sim(sim, tick_duration);
+        if (sim->events.ball_hit_paddle) {
+            struct vec2 v = sim->ball.velocity;
+            float speed = sqrtf((v.x * v.x) + (v.y * v.y));
+            stats->hits++;
+            stats->ball_speed_sum += speed;
+            stats->max_ball_speed = fmaxf(stats->max_ball_speed, speed);
+        }
+        sim->events = (struct sim_events){0};
+        ticks++;
+    }
+
+    stats->matches++;
+    stats->ticks += ticks;
+    stats->points += sim->paddle_1.score + sim->paddle_2.score;
+    if (!sim->round_over) {
+        stats->unfinished++;
+    } else if (sim->paddle_1.score == sim->max_score) {
+        stats->wins_1++;
+    }
+}
+
+static void run_task(long task, void *data) {
+    struct sweep *sweep = data;
+    const struct options *options = sweep->options;
+    long index = task / sweep->tasks_per_combination;
+    long first_match = (task % sweep->tasks_per_combination) *
+                       MATCHES_PER_TASK;
+    long last_match = first_match + MATCHES_PER_TASK;
+    if (last_match > options->matches) {
+        last_match = options->matches;
+    }
+
+    struct combination c = get_combination(options, index);
+    struct stats stats = {0};
+    for (long match = first_match; match < last_match; match++) {
+        struct sim sim = make_match(options, c, match);
+        play_match(options, &sim, &stats);
+    }
+    sweep->task_stats[task] = stats;
+}
+
+// Stats are always added up in the order of the tasks so that the sums of
+// floating point numbers don't depend on which thread finished first.
+static void add_stats(struct stats *sum, const struct stats *stats) {
+    sum->matches += stats->matches;
+    sum->wins_1 += stats->wins_1;
+    sum->unfinished += stats->unfinished;
+    sum->points += stats->points;
+    sum->hits += stats->hits;
+    sum->ticks += stats->ticks;
+    sum->ball_speed_sum += stats->ball_speed_sum;
+    sum->max_ball_speed = fmaxf(sum->max_ball_speed, stats->max_ball_speed);
+}
+
+static void report(const struct sweep *sweep) {
+    printf("%9s %7s %7s %6s %6s %6s %6s %8s %6s %6s %7s %7s %10s\n",
+           "sharpness", "speed_1", "speed_2", "bias_1", "bias_2", "idle_1",
+           "idle_2", "matches", "wins_1", "rally", "speed", "max",
+           "unfinished");
+    for (long i = 0; i < sweep->combinations_length; i++) {
+        struct stats sum = {0};
+        for (long j = 0; j < sweep->tasks_per_combination; j++) {
+            add_stats(&sum,
+                      &sweep->task_stats[i * sweep->tasks_per_combination + j]);
+        }
+        long finished = sum.matches - sum.unfinished;
+
+        struct combination c = get_combination(sweep->options, i);
+        printf("%9.3f %7.3f %7.3f %6.2f %6.2f %6d %6d %8ld %6.3f %6.2f %7.1f "
+               "%7.1f %10ld\n",
+               c.sharpness, c.speed_1, c.speed_2, c.bias_1, c.bias_2,
+               c.idle_offset_1, c.idle_offset_2, sum.matches,
+               (finished > 0) ? sum.wins_1 / (double)finished : 0.0,
+               (sum.points > 0) ? sum.hits / (double)sum.points : 0.0,
+               (sum.hits > 0) ? sum.ball_speed_sum / sum.hits : 0.0,
+               sum.max_ball_speed, sum.unfinished);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    struct values one = {.values = {1.0f}, .length = 1};
+    struct options options = {
+        .matches = 1000,
+        .max_score = 11,
+        .tick_rate = 120,
+        .max_ticks = 10000000,
+        .seed = time(NULL),
+        .threads = platform_cpu_count(),
+        .sharpness = one,
+        .speed_1 = one,
+        .speed_2 = one,
+        .bias_1 = one,
+        .bias_2 = one,
+        .idle_offset_1 = {.values = {LOGICAL_HEIGHT / 8}, .length = 1},
+        .idle_offset_2 = {.values = {LOGICAL_HEIGHT / 8}, .length = 1},
+    };
+    if (!parse_options(argc, argv, &options)) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    struct sweep sweep = {
+        .options = &options,
+        .combinations_length = count_combinations(&options),
+        .tasks_per_combination =
+            (options.matches + MATCHES_PER_TASK - 1) / MATCHES_PER_TASK,
+    };
+    long tasks = sweep.combinations_length * sweep.tasks_per_combination;
+    sweep.task_stats = calloc(tasks, sizeof(struct stats));
+    if (sweep.task_stats == NULL) {
+        fprintf(stderr, "Couldn't allocate the stats of %ld tasks\n", tasks);
+        return EXIT_FAILURE;
+    }
+
+    double start_time = platform_time();
+    if (!run_tasks(options.threads, tasks, run_task, &sweep)) {
+        fprintf(stderr, "Couldn't start the threads\n");
+        return EXIT_FAILURE;
+    }
+    double elapsed = platform_time() - start_time;
+
+    printf("seed: %" PRIu64 "\n", options.seed);
+    report(&sweep);
+
+    // Timings go to the standard error so that the standard output of two
+    // sweeps with the same options can be compared.
+    long long ticks = 0;
+    for (long i = 0; i < tasks; i++) {
+        ticks += sweep.task_stats[i].ticks;
+    }
+    fprintf(stderr,
+            "threads: %d\nelapsed: %.3f s\nmatches/sec: %.1f\n"
+            "ticks/sec: %.0f\n",
+            options.threads, elapsed,
+            sweep.combinations_length * options.matches / elapsed,
+            ticks / elapsed);
+
+    free(sweep.task_stats);
+    return EXIT_SUCCESS;
+}
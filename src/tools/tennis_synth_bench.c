@@ -0,0 +1,162 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../synth.h"
+#include "platform.h"
+
+// Compare the cost of synthesizing the tones of the game with the band-limited
+// oscillator against the naive square wave it replaced, and measure the cost
+// of mixing a full pool of voices.
+
+#define SAMPLE_RATE 44100
+#define BUFFER_LENGTH 512 // samples per call, like the largest audio period
+
+struct options {
+    long samples;
+    float freq; // in Hz
+    int sample_rate;
+};
+
+static void print_usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -n, --samples N     number of samples to synthesize (default: "
+            "100000000)\n"
+            "  --freq HZ           frequency of the tone (default: 480)\n"
+            "  --sample-rate HZ    samples per second (default: 44100)\n",
+            program);
+}
+
+static bool parse_options(int argc, char *argv[], struct options *options) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            return false;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Unknown or incomplete option: %s\n", arg);
+            return false;
+        }
+        const char *value = argv[++i];
+        if (strcmp(arg, "-n") == 0 || strcmp(arg, "--samples") == 0) {
+            options->samples = strtol(value, NULL, 10);
+        } else if (strcmp(arg, "--freq") == 0) {
+            options->freq = strtof(value, NULL);
+        } else if (strcmp(arg, "--sample-rate") == 0) {
+            options->sample_rate = strtol(value, NULL, 10);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            return false;
+        }
+    }
+    return options->samples > 0 && options->sample_rate > 0 &&
+           options->freq > 0 && options->freq < options->sample_rate / 2.0f;
+}
+
+// The square wave the game used to synthesize, as it was.
+static int square_wave_sample(int sample_rate, int sample_idx, int freq,
+                              int amplitude) {
+    int wave_period = sample_rate / freq;
+    int half_period = wave_period / 2;
+    if ((sample_idx / half_period) % 2 == 0) {
+        return amplitude;
+    }
+    return -amplitude;
+}
+
+// Return a checksum of the samples so that they can't be optimized away.
+static long run_naive(struct options options, int16_t *buffer) {
+    long checksum = 0;
+    uint32_t sample_idx = 0;
+    for (long i = 0; i < options.samples; i += BUFFER_LENGTH) {
+        for (int j = 0; j < BUFFER_LENGTH; j++) {
+            buffer[j] = square_wave_sample(options.sample_rate, sample_idx + j,
+                                           (int)options.freq, INT16_MAX / 40);
+        }
+        sample_idx += BUFFER_LENGTH;
+        checksum += buffer[i % BUFFER_LENGTH];
+    }
+    return checksum;
+}
+
+static long run_oscillator(struct options options, int16_t *buffer) {
+    long checksum = 0;
+    struct oscillator osc = make_oscillator(options.freq, options.sample_rate);
+    for (long i = 0; i < options.samples; i += BUFFER_LENGTH) {
+        generate_square_wave(&osc, INT16_MAX / 40, buffer, BUFFER_LENGTH);
+        checksum += buffer[i % BUFFER_LENGTH];
+    }
+    return checksum;
+}
+
+// Start a voice every buffer so that the pool is always full and voices get
+// stolen.
+static long run_mixer(struct options options, int16_t *buffer) {
+    long checksum = 0;
+    struct mixer mixer = {0};
+    for (long i = 0; i < options.samples; i += BUFFER_LENGTH) {
+        start_voice(&mixer, options.freq, options.sample_rate / 10,
+                    options.sample_rate);
+        mix_voices(&mixer, INT16_MAX / 40, buffer, BUFFER_LENGTH);
+        checksum += buffer[i % BUFFER_LENGTH];
+    }
+    return checksum;
+}
+
+static double report(const char *generator, long samples, double elapsed,
+                     long checksum) {
+    printf("generator: %s\n", generator);
+    printf("elapsed: %.3f s\n", elapsed);
+    printf("samples/sec: %.0f\n", samples / elapsed);
+    printf("checksum: %ld\n", checksum);
+    return samples / elapsed;
+}
+
+int main(int argc, char *argv[]) {
+    struct options options = {
+        .samples = 100000000,
+        .freq = 480.0f,
+        .sample_rate = SAMPLE_RATE,
+    };
+    if (!parse_options(argc, argv, &options)) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    // Whole buffers are synthesized.
+    options.samples += BUFFER_LENGTH - 1;
+    options.samples -= options.samples % BUFFER_LENGTH;
+
+    static int16_t buffer[BUFFER_LENGTH];
+
+    double start_time = platform_time();
+    long checksum = run_naive(options, buffer);
+    double naive_samples_per_sec = report(
+        "naive", options.samples, platform_time() - start_time, checksum);
+
+    printf("\n");
+    start_time = platform_time();
+    checksum = run_oscillator(options, buffer);
+    double samples_per_sec =
+        report("polyblep", options.samples, platform_time() - start_time,
+               checksum);
+
+    printf("\nspeedup: %.1fx\n", samples_per_sec / naive_samples_per_sec);
+    // The naive square wave rounds its period down to a whole number of
+    // samples.
+    printf("naive frequency: %.2f Hz\n",
+           options.sample_rate /
+               (double)((options.sample_rate / (int)options.freq) / 2 * 2));
+
+    printf("\n");
+    start_time = platform_time();
+    checksum = run_mixer(options, buffer);
+    char mixer_generator[64];
+    snprintf(mixer_generator, sizeof(mixer_generator), "mixer (%d voices)",
+             SYNTH_MAX_VOICES);
+    report(mixer_generator, options.samples, platform_time() - start_time,
+           checksum);
+    return EXIT_SUCCESS;
+}